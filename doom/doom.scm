@@ -1,5 +1,6 @@
 ;; -*- Mode: Irken -*-
 
-(include "doom/kqueue.scm")
+(include "lib/basis.scm")
+(include "doom/poller.scm")
 (include "doom/socket.scm")
 (include "doom/scheduler.scm")
@@ -1,10 +1,12 @@
 ;; -*- Mode: Irken -*-
 
 (include "doom/doom.scm")
+(include "lib/os.scm")
 
 (define (serve ip port)
   (let ((fd (socket AF_INET SOCK_STREAM 0))
         (addr (make-in-addr ip port)))
+    (set-reuseport fd)
     (bind fd addr)
     (listen fd 5)
     (print-string "starting server...\n")
@@ -19,8 +21,10 @@
           (send fd s)
           (loop (recv fd 512))))
   (print-string "exiting client...\n")
-  (close fd)
+  (poller/close fd)
   )
 
+;; the optional argument is how many processes to serve with.
+(poller/fork-workers (if (> sys.argc 1) (string->int sys.argv[1]) 1))
 (serve "0.0.0.0" 9999)
 (poller/wait-and-schedule)
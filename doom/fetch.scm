@@ -9,7 +9,7 @@
     (printn (send sfd "HEAD / HTTP/1.0\r\n\r\n"))
     (print-string (recv sfd 1024))
     (print-string "done!\n")
-    (close sfd)
+    (poller/close sfd)
     ))
 
 (let ((ip "72.52.84.226"))
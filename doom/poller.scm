@@ -0,0 +1,627 @@
+;; -*- Mode: Irken -*-
+
+;; the OS event interface used by the scheduler: epoll on linux, kqueue
+;;   elsewhere, picked by the C preprocessor when the program is compiled.
+;;
+;; epoll: each fd is registered once, edge-triggered, for both reading and
+;;   writing.  The scheduler only waits on an fd after an operation on it
+;;   would have blocked, so the next edge is always the one it wants.  An
+;;   fd must be forgotten (poller/close does this) before it is closed,
+;;   since its number may come back for a new socket.
+;; kqueue: each wait adds a one-shot event to a list of changes, which is
+;;   handed to the kernel by the next kevent() call.
+;; io_uring (linux, compiled with -DDOOM_IO_URING): rather than wait
+;;   for an fd to be ready, socket operations are submitted to the kernel
+;;   whole and the thread sleeps until the operation completes (see
+;;   poller/recv and friends in doom/scheduler.scm).  Submissions queue up
+;;   in the ring and go in with the next wait, so a batch of them costs one
+;;   io_uring_enter() call.  The kernel works on the data after the thread
+;;   has gone to sleep, while the collector may move the heap, so each
+;;   request carries its own malloc'd buffer and address, and data is
+;;   copied between those and Irken strings.
+
+(cinclude "sys/types.h")
+(cinclude "errno.h")
+
+(cverbatim "
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__linux__) && defined(DOOM_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#define POLLER_URING 1
+#define POLLER_URING_ENTRIES 256
+struct poller_request {
+  int res;
+  int next_free;
+  char * buf;
+  struct sockaddr_in addr;
+  socklen_t addrlen;
+};
+struct poller {
+  int fd;
+  unsigned * sq_head;
+  unsigned * sq_tail;
+  unsigned * sq_mask;
+  unsigned * sq_array;
+  unsigned sq_entries;
+  struct io_uring_sqe * sqes;
+  unsigned * cq_head;
+  unsigned * cq_tail;
+  unsigned * cq_mask;
+  struct io_uring_cqe * cqes;
+  unsigned pending;
+  // requests stay put while the kernel has them: this is a table of pointers.
+  struct poller_request ** reqs;
+  int nreqs;
+  int free;
+};
+struct poller_event {
+  int id;
+  int res;
+};
+#elif defined(__linux__)
+#include <sys/epoll.h>
+struct poller {
+  int fd;
+  int narmed;
+  unsigned char * armed;
+};
+#define poller_event epoll_event
+#else
+#include <sys/event.h>
+#define POLLER_MAX_CHANGES 1000
+struct poller {
+  int fd;
+  int nchanges;
+  struct kevent changes[POLLER_MAX_CHANGES];
+};
+#define poller_event kevent
+#endif
+
+#define POLLER_READ  1
+#define POLLER_WRITE 2
+#define POLLER_DONE  4
+
+#ifdef POLLER_URING
+
+// undo a poller_open that got as far as mapping <sq> and <cq> (either
+//   may be NULL, and they may be the same), keeping its errno.
+static int
+poller_open_failed (struct poller * p, char * sq, size_t sq_bytes, char * cq, size_t cq_bytes)
+{
+  int e = errno;
+  if (cq && (cq != sq)) {
+    munmap (cq, cq_bytes);
+  }
+  if (sq) {
+    munmap (sq, sq_bytes);
+  }
+  close (p->fd);
+  errno = e;
+  return -1;
+}
+
+static int
+poller_open (struct poller * p)
+{
+  struct io_uring_params params;
+  size_t sq_bytes, cq_bytes;
+  char * sq;
+  char * cq;
+  memset (&params, 0, sizeof (params));
+  p->fd = syscall (__NR_io_uring_setup, POLLER_URING_ENTRIES, &params);
+  if (p->fd == -1) {
+    return -1;
+  }
+  sq_bytes = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+  cq_bytes = params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    sq_bytes = cq_bytes = (sq_bytes > cq_bytes) ? sq_bytes : cq_bytes;
+  }
+  sq = mmap (NULL, sq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, p->fd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) {
+    return poller_open_failed (p, NULL, 0, NULL, 0);
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    cq = sq;
+  } else {
+    cq = mmap (NULL, cq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, p->fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) {
+      return poller_open_failed (p, sq, sq_bytes, NULL, 0);
+    }
+  }
+  p->sqes = mmap (NULL, params.sq_entries * sizeof (struct io_uring_sqe),
+                  PROT_READ | PROT_WRITE, MAP_SHARED, p->fd, IORING_OFF_SQES);
+  if (p->sqes == MAP_FAILED) {
+    return poller_open_failed (p, sq, sq_bytes, cq, cq_bytes);
+  }
+  p->sq_head = (unsigned *) (sq + params.sq_off.head);
+  p->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+  p->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+  p->sq_array = (unsigned *) (sq + params.sq_off.array);
+  p->sq_entries = params.sq_entries;
+  p->cq_head = (unsigned *) (cq + params.cq_off.head);
+  p->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+  p->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+  p->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+  p->free = -1;
+  return p->fd;
+}
+
+static int
+poller_enter (struct poller * p, unsigned min_complete)
+{
+  int r = syscall (__NR_io_uring_enter, p->fd, p->pending, min_complete,
+                   min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+  if (r >= 0) {
+    p->pending -= r;
+  }
+  return r;
+}
+
+// a new request and a cleared sqe for it, or NULL.
+static struct poller_request *
+poller_new_request (struct poller * p, int * id, struct io_uring_sqe ** sqe)
+{
+  unsigned tail = *p->sq_tail;
+  unsigned index;
+  struct poller_request * req;
+  if (tail - __atomic_load_n (p->sq_head, __ATOMIC_ACQUIRE) == p->sq_entries) {
+    if (poller_enter (p, 0) == -1) {
+      return NULL;
+    }
+    if (tail - __atomic_load_n (p->sq_head, __ATOMIC_ACQUIRE) == p->sq_entries) {
+      errno = EBUSY;
+      return NULL;
+    }
+  }
+  if (p->free == -1) {
+    struct poller_request ** reqs = realloc (p->reqs, sizeof (req) * (p->nreqs + 1));
+    if (!reqs) {
+      return NULL;
+    }
+    p->reqs = reqs;
+    req = calloc (1, sizeof (struct poller_request));
+    if (!req) {
+      return NULL;
+    }
+    p->reqs[p->nreqs] = req;
+    *id = p->nreqs++;
+  } else {
+    *id = p->free;
+    req = p->reqs[*id];
+    p->free = req->next_free;
+  }
+  req->buf = NULL;
+  index = tail & *p->sq_mask;
+  *sqe = p->sqes + index;
+  memset (*sqe, 0, sizeof (struct io_uring_sqe));
+  (*sqe)->user_data = *id;
+  p->sq_array[index] = index;
+  return req;
+}
+
+// put request <id> back on the free list.
+static void
+poller_free_request (struct poller * p, int id)
+{
+  struct poller_request * req = p->reqs[id];
+  free (req->buf);
+  req->buf = NULL;
+  req->next_free = p->free;
+  p->free = id;
+}
+
+static int
+poller_push (struct poller * p, int id)
+{
+  __atomic_store_n (p->sq_tail, *p->sq_tail + 1, __ATOMIC_RELEASE);
+  p->pending++;
+  return id;
+}
+
+// <dst>, if given, is a pinned buffer for the kernel to receive into
+//   directly.  otherwise the data goes into one of our own, and
+//   poller_finish copies it out.
+static int
+poller_submit_recv (struct poller * p, int fd, char * dst, int n)
+{
+  struct io_uring_sqe * sqe;
+  int id;
+  struct poller_request * req = poller_new_request (p, &id, &sqe);
+  if (!req) {
+    return -1;
+  }
+  if (!dst && !(req->buf = malloc (n))) {
+    poller_free_request (p, id);
+    return -1;
+  }
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t) (dst ? dst : req->buf);
+  sqe->len = n;
+  return poller_push (p, id);
+}
+
+// unless <data> is pinned, the collector may move it before the kernel
+//   gets to it, so it is copied first.
+static int
+poller_submit_send (struct poller * p, int fd, const char * data, int n, int pinned)
+{
+  struct io_uring_sqe * sqe;
+  int id;
+  struct poller_request * req = poller_new_request (p, &id, &sqe);
+  if (!req) {
+    return -1;
+  }
+  if (!pinned && !(req->buf = malloc (n))) {
+    poller_free_request (p, id);
+    return -1;
+  }
+  if (!pinned) {
+    memcpy (req->buf, data, n);
+  }
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t) (pinned ? data : req->buf);
+  sqe->len = n;
+  return poller_push (p, id);
+}
+
+static int
+poller_submit_accept (struct poller * p, int fd)
+{
+  struct io_uring_sqe * sqe;
+  int id;
+  struct poller_request * req = poller_new_request (p, &id, &sqe);
+  if (!req) {
+    return -1;
+  }
+  req->addrlen = sizeof (struct sockaddr_in);
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t) &req->addr;
+  sqe->addr2 = (uintptr_t) &req->addrlen;
+  return poller_push (p, id);
+}
+
+static int
+poller_submit_connect (struct poller * p, int fd, struct sockaddr_in * addr)
+{
+  struct io_uring_sqe * sqe;
+  int id;
+  struct poller_request * req = poller_new_request (p, &id, &sqe);
+  if (!req) {
+    return -1;
+  }
+  req->addr = *addr;
+  sqe->opcode = IORING_OP_CONNECT;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t) &req->addr;
+  sqe->off = sizeof (struct sockaddr_in);
+  return poller_push (p, id);
+}
+
+// the result of a completed request, copying any data it received into
+//   <dst> (unless it was received there directly).  the request is free
+//   for reuse afterwards.
+static int
+poller_finish (struct poller * p, int id, char * dst, int n)
+{
+  struct poller_request * req = p->reqs[id];
+  int res = req->res;
+  if (dst && req->buf && res > 0) {
+    memcpy (dst, req->buf, (res < n) ? res : n);
+  }
+  poller_free_request (p, id);
+  if (res < 0) {
+    errno = -res;
+    return -1;
+  }
+  return res;
+}
+
+static int
+poller_reap (struct poller * p, struct poller_event * events, int n)
+{
+  unsigned head = *p->cq_head;
+  unsigned tail = __atomic_load_n (p->cq_tail, __ATOMIC_ACQUIRE);
+  int got = 0;
+  while (head != tail && got < n) {
+    struct io_uring_cqe * cqe = p->cqes + (head & *p->cq_mask);
+    events[got].id = (int) cqe->user_data;
+    events[got].res = cqe->res;
+    p->reqs[events[got].id]->res = cqe->res;
+    head++;
+    got++;
+  }
+  __atomic_store_n (p->cq_head, head, __ATOMIC_RELEASE);
+  return got;
+}
+
+// submits everything queued, and waits for a completion unless some
+//   are already in.
+static int
+poller_wait (struct poller * p, struct poller_event * events, int n)
+{
+  int got = poller_reap (p, events, n);
+  if (p->pending || !got) {
+    if (poller_enter (p, got ? 0 : 1) == -1) {
+      return got ? got : -1;
+    }
+    if (!got) {
+      got = poller_reap (p, events, n);
+    }
+  }
+  return got;
+}
+
+static int
+poller_event_fd (struct poller_event * events, int i)
+{
+  return events[i].id;
+}
+
+static int
+poller_event_ready (struct poller_event * events, int i)
+{
+  return POLLER_DONE;
+}
+
+static int
+poller_watch (struct poller * p, int fd, int dir)
+{
+  return 0;
+}
+
+static void
+poller_forget (struct poller * p, int fd)
+{
+}
+
+#else
+
+
+static int
+poller_open (struct poller * p)
+{
+#ifdef __linux__
+  p->fd = epoll_create1 (0);
+#else
+  p->fd = kqueue();
+#endif
+  return p->fd;
+}
+
+static int
+poller_watch (struct poller * p, int fd, int dir)
+{
+#ifdef __linux__
+  struct epoll_event ev;
+  if (fd >= p->narmed) {
+    int n = p->narmed ? p->narmed : 64;
+    unsigned char * armed;
+    while (n <= fd) {
+      n *= 2;
+    }
+    armed = realloc (p->armed, n);
+    if (!armed) {
+      errno = ENOMEM;
+      return -1;
+    }
+    memset (armed + p->narmed, 0, n - p->narmed);
+    p->armed = armed;
+    p->narmed = n;
+  }
+  if (p->armed[fd]) {
+    return 0;
+  }
+  ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  ev.data.fd = fd;
+  if (epoll_ctl (p->fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+    return -1;
+  }
+  p->armed[fd] = 1;
+  return 0;
+#else
+  if (p->nchanges == POLLER_MAX_CHANGES) {
+    if (kevent (p->fd, p->changes, p->nchanges, NULL, 0, NULL) == -1) {
+      return -1;
+    }
+    p->nchanges = 0;
+  }
+  EV_SET (p->changes + p->nchanges, fd, (dir == POLLER_READ) ? EVFILT_READ : EVFILT_WRITE, EV_ADD | EV_ONESHOT, 0, 0, 0);
+  p->nchanges++;
+  return 0;
+#endif
+}
+
+static void
+poller_forget (struct poller * p, int fd)
+{
+#ifdef __linux__
+  if (fd < p->narmed && p->armed[fd]) {
+    epoll_ctl (p->fd, EPOLL_CTL_DEL, fd, NULL);
+    p->armed[fd] = 0;
+  }
+#endif
+}
+
+static int
+poller_wait (struct poller * p, struct poller_event * events, int n)
+{
+#ifdef __linux__
+  return epoll_wait (p->fd, events, n, -1);
+#else
+  int r = kevent (p->fd, p->changes, p->nchanges, events, n, NULL);
+  p->nchanges = 0;
+  return r;
+#endif
+}
+
+static int
+poller_event_fd (struct poller_event * events, int i)
+{
+#ifdef __linux__
+  return events[i].data.fd;
+#else
+  return (int) events[i].ident;
+#endif
+}
+
+// which of POLLER_READ and POLLER_WRITE the event wakes.  an error or
+//   hangup wakes both, so that the waiting threads see it.
+static int
+poller_event_ready (struct poller_event * events, int i)
+{
+#ifdef __linux__
+  uint32_t e = events[i].events;
+  int r = 0;
+  if (e & (EPOLLERR | EPOLLHUP)) {
+    return POLLER_READ | POLLER_WRITE;
+  }
+  if (e & (EPOLLIN | EPOLLRDHUP)) {
+    r |= POLLER_READ;
+  }
+  if (e & EPOLLOUT) {
+    r |= POLLER_WRITE;
+  }
+  return r;
+#else
+  return (events[i].filter == EVFILT_READ) ? POLLER_READ : POLLER_WRITE;
+#endif
+}
+
+// only io_uring has operations to submit.
+#define poller_submit_recv(p, fd, dst, n) (errno = ENOSYS, -1)
+#define poller_submit_send(p, fd, data, n, pinned) (errno = ENOSYS, -1)
+#define poller_submit_accept(p, fd) (errno = ENOSYS, -1)
+#define poller_submit_connect(p, fd, addr) (errno = ENOSYS, -1)
+#define poller_finish(p, id, dst, n) (errno = ENOSYS, -1)
+
+#endif
+
+#ifdef POLLER_URING
+#define POLLER_COMPLETIONS 1
+#else
+#define POLLER_COMPLETIONS 0
+#endif
+
+#include <unistd.h>
+#include <signal.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+// on linux a worker dies with the process that forked it.
+static int
+poller_fork (void)
+{
+  pid_t pid = fork();
+#ifdef __linux__
+  if (pid == 0) {
+    prctl (PR_SET_PDEATHSIG, SIGTERM);
+  }
+#endif
+  return (int) pid;
+}
+")
+
+(define POLLER_READ  (%%cexp int "POLLER_READ"))
+(define POLLER_WRITE (%%cexp int "POLLER_WRITE"))
+(define POLLER_DONE  (%%cexp int "POLLER_DONE"))
+
+;; true if socket operations are submitted whole (io_uring).
+(define POLLER_COMPLETIONS (%%cexp bool "POLLER_COMPLETIONS"))
+
+(define (poller-open nevents)
+  (let ((p (%callocate (struct poller) 1)))
+    (syscall (%%cexp ((buffer (struct poller)) -> int) "poller_open (%0)" p))
+    {os=p
+     nevents=nevents
+     events=(%callocate (struct poller_event) nevents)}))
+
+;; the OS side of <p> goes, but not its ring mappings (io_uring): after a
+;;   fork they are shared with the parent, which is still using them.
+(define (poller-close p)
+  (close (%%cexp ((buffer (struct poller)) -> int) "%0->fd" p.os)))
+
+;; arrange for the next poller-wait to report <fd> ready for <dir>.
+(define (poller-watch p fd dir)
+  (syscall
+   (%%cexp ((buffer (struct poller)) int int -> int)
+	   "poller_watch (%0, %1, %2)" p.os fd dir)))
+
+(define (poller-forget p fd)
+  (%%cexp ((buffer (struct poller)) int -> undefined)
+	  "(poller_forget (%0, %1), PXLL_UNDEFINED)" p.os fd))
+
+;; blocks until something is ready, returns how many events there are.
+(define (poller-wait p)
+  (let loop ()
+    (let ((n (%%cexp ((buffer (struct poller)) (buffer (struct poller_event)) int -> int)
+		     "poller_wait (%0, %1, %2)" p.os p.events p.nevents)))
+      (cond ((>= n 0) n)
+	    ((= (%%cexp (-> int) "errno") (%%cexp int "EINTR")) (loop))
+	    (else (syscall n))))))
+
+(define (poller-event-fd p i)
+  (%%cexp ((buffer (struct poller_event)) int -> int) "poller_event_fd (%0, %1)" p.events i))
+
+(define (poller-event-ready p i)
+  (%%cexp ((buffer (struct poller_event)) int -> int) "poller_event_ready (%0, %1)" p.events i))
+
+;; io_uring only: these queue a request and return its id.  once the
+;;   request is done (see poller/complete), poller-finish returns its
+;;   result.  the kernel reads or writes a pinned string in place (see
+;;   make-pinned-string): the caller must keep it referenced until then.
+
+(define (poller-submit-recv p fd buf n)
+  (%%cexp ((raw string) int -> undefined) "range_check (((pxll_string *)(%0))->len + 1, %1)" buf n)
+  (syscall
+   (if (string-pinned? buf)
+       (%%cexp ((buffer (struct poller)) int string int -> int)
+	       "poller_submit_recv (%0, %1, %2, %3)" p.os fd buf n)
+       (%%cexp ((buffer (struct poller)) int int -> int)
+	       "poller_submit_recv (%0, %1, NULL, %2)" p.os fd n))))
+
+(define (poller-submit-send p fd s)
+  (syscall
+   (%%cexp ((buffer (struct poller)) int string int int -> int)
+	   "poller_submit_send (%0, %1, %2, %3, %4)"
+	   p.os fd s (string-length s) (if (string-pinned? s) 1 0))))
+
+(define (poller-submit-accept p fd)
+  (syscall
+   (%%cexp ((buffer (struct poller)) int -> int)
+	   "poller_submit_accept (%0, %1)" p.os fd)))
+
+(define (poller-submit-connect p fd addr)
+  (syscall
+   (%%cexp ((buffer (struct poller)) int (buffer (struct sockaddr_in)) -> int)
+	   "poller_submit_connect (%0, %1, %2)" p.os fd addr)))
+
+(define (poller-finish p req)
+  (syscall
+   (%%cexp ((buffer (struct poller)) int -> int)
+	   "poller_finish (%0, %1, NULL, 0)" p.os req)))
+
+;; the string a send request was given goes along, so that it is still
+;;   referenced while the kernel reads it.
+(define (poller-finish-send p req s)
+  (syscall
+   (%%cexp ((buffer (struct poller)) int string -> int)
+	   "poller_finish (%0, %1, NULL, 0)" p.os req s)))
+
+;; copies what a recv request received into <buf>, if it wasn't received
+;;   there directly.
+(define (poller-finish-into p req buf)
+  (syscall
+   (%%cexp ((buffer (struct poller)) int string int -> int)
+	   "poller_finish (%0, %1, %2, %3)" p.os req buf (string-length buf))))
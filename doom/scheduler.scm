@@ -1,18 +1,34 @@
 ;; -*- Mode: Irken -*-
 
-;; for each EVFILT, we have separate map of ident=>continuation
+;; for reading and for writing, we have a separate map of fd=>continuation,
+;;   and with io_uring a map of request=>continuation.
 
 (define (make-poller)
-  { kqfd	= (kqueue)
+  { os		= (poller-open 1000)
     runnable	= (queue/make)
     nwait	= 0 ;; how many events are waiting?
-    filters	= (make-vector EVFILT_SYSCOUNT (tree/empty))
-    ievents	= (make-changelist 1000)
-    oevents	= (make-changelist 1000)
+    waiting	= (make-vector 3 (tree/empty)) ;; indexed by (dir-index dir)
+    buffers	= (tree/empty) ;; fd=>pinned receive buffer (io_uring)
     })
 
 (define the-poller (make-poller))
 
+;; to use more than one core, run <n> copies of the program from here on,
+;;   each in its own process with its own heap and poller.  returns which
+;;   copy this is, from 0 (the original) to n-1.  call it before any
+;;   thread waits, and give each copy its own listening socket with
+;;   set-reuseport, so the kernel shares connections out between them.
+(define (poller/fork-workers n)
+  (let loop ((i 1))
+    (if (>= i n)
+	0
+	(let ((pid (syscall (%%cexp (-> int) "poller_fork()"))))
+	  (cond ((= pid 0)
+		 (poller-close the-poller.os)
+		 (set! the-poller (make-poller))
+		 i)
+		(else (loop (+ i 1))))))))
+
 (define (poller/enqueue k)
   (queue/add the-poller.runnable k))
 
@@ -34,32 +50,35 @@
     (maybe:yes k) -> (putcc k #u)
     (maybe:no)	  -> (poller/wait-and-schedule)))
 
-;; these funs know that EVFILT values are consecutive small negative ints
+(define (dir-index dir)
+  (cond ((= dir POLLER_READ) 0)
+	((= dir POLLER_WRITE) 1)
+	(else 2)))
 
 ;; here's a question: is this an abuse of macros?  Does it make the code
 ;;   harder or easier to read?  I think this is related to 'setf' in CL -
 ;;   since the target of set! can't be a funcall.
-(defmacro kfilt (kfilt f) -> the-poller.filters[(- 0 f)])
+(defmacro waiting (waiting dir) -> the-poller.waiting[(dir-index dir)])
 
-(define (poller/lookup-event ident filter)
-  (tree/member (kfilt filter) < ident))
+(define (poller/lookup-event fd dir)
+  (tree/member (waiting dir) < fd))
 
-(define (poller/add-event ident filter k)
+(define (poller/add-event fd dir k)
   (set! the-poller.nwait (+ 1 the-poller.nwait))
-  (tree/insert! (kfilt filter) < ident k))
+  (tree/insert! (waiting dir) < fd k))
 
-(define (poller/delete-event ident filter)
-  (tree/delete! (kfilt filter) ident < =))
-  (set! the-poller.nwait (- the-poller.nwait 1))
+(define (poller/delete-event fd dir)
+  (tree/delete! (waiting dir) fd < =)
+  (set! the-poller.nwait (- the-poller.nwait 1)))
 
-;; put the current thread to sleep while waiting for the kevent (ident, filter).
-(define (poller/wait-for ident filter)
+;; put the current thread to sleep until <fd> is ready for <dir>.
+(define (poller/wait-for fd dir)
   (let ((k (getcc)))
-    (match (poller/lookup-event ident filter) with
+    (match (poller/lookup-event fd dir) with
       (maybe:no)
       -> (begin
-	   (add-kevent the-poller.ievents ident filter EV_ADDONE)
-	   (poller/add-event ident filter k)
+	   (poller-watch the-poller.os fd dir)
+	   (poller/add-event fd dir k)
 	   (poller/dispatch)
 	   #u
 	   )
@@ -67,30 +86,86 @@
       )))
 
 (define (poller/wait-for-read fd)
-  (poller/wait-for fd EVFILT_READ))
+  (poller/wait-for fd POLLER_READ))
 
 (define (poller/wait-for-write fd)
-  (poller/wait-for fd EVFILT_WRITE))
-
-(define poller/enqueue-waiting-thread
-  (:kev ident filter)
-  -> (match (poller/lookup-event ident filter) with
-	 (maybe:yes k) -> (begin
-			    (poller/delete-event ident filter)
-			    (poller/enqueue k))
-	 (maybe:no)    -> (raise (:PollerNoSuchEvent ident filter))))
+  (poller/wait-for fd POLLER_WRITE))
+
+;; io_uring: sleep until request <req> is done.  poller/recv and friends
+;;   are what doom/socket.scm uses in place of trying a call and waiting
+;;   when it would block.  the buffer given to poller/recv or poller/send
+;;   is used again after the request is done, which keeps a pinned one
+;;   alive while the kernel has it.
+(define (poller/complete req)
+  (poller/wait-for req POLLER_DONE))
+
+(define (poller/recv fd buf n)
+  (let ((req (poller-submit-recv the-poller.os fd buf n)))
+    (poller/complete req)
+    (poller-finish-into the-poller.os req buf)))
+
+(define (poller/send fd s)
+  (let ((req (poller-submit-send the-poller.os fd s)))
+    (poller/complete req)
+    (poller-finish-send the-poller.os req s)))
+
+;; a pinned buffer of at least <size> bytes for receiving on <fd>.  each
+;;   socket keeps its own from one recv to the next (there is only ever
+;;   one reader per socket), so it costs one allocation per connection
+;;   rather than one per request.
+(define (poller/recv-buffer fd size)
+  (match (tree/member the-poller.buffers < fd) with
+    (maybe:yes buf)
+    -> (if (>= (string-length buf) size)
+	   buf
+	   (begin
+	     (tree/delete! the-poller.buffers fd < =)
+	     (poller/recv-buffer fd size)))
+    (maybe:no)
+    -> (let ((buf (make-pinned-string size)))
+	 (tree/insert! the-poller.buffers < fd buf)
+	 buf)))
+
+(define (poller/accept fd)
+  (let ((req (poller-submit-accept the-poller.os fd)))
+    (poller/complete req)
+    (poller-finish the-poller.os req)))
+
+(define (poller/connect fd addr)
+  (let ((req (poller-submit-connect the-poller.os fd addr)))
+    (poller/complete req)
+    (poller-finish the-poller.os req)))
+
+;; the threads waiting on <fd> must already have woken up.
+(define (poller/close fd)
+  (poller-forget the-poller.os fd)
+  (tree/delete! the-poller.buffers fd < =)
+  (close fd))
+
+;; an event may be for a direction nobody is waiting on: with epoll, an fd
+;;   is watched both ways for as long as it is open.
+(define (poller/enqueue-waiting-thread fd dir)
+  (match (poller/lookup-event fd dir) with
+    (maybe:yes k) -> (begin
+		       (poller/delete-event fd dir)
+		       (poller/enqueue k))
+    (maybe:no)    -> #u))
 
 (define (poller/wait-and-schedule)
-  ;; all the runnable threads have done their bit, now throw it to kevent().
+  ;; all the runnable threads have done their bit, now wait for the OS.
   (if (= the-poller.nwait 0)
       (print-string "no events, will wait forever!\n"))
-  (let ((n (syscall (kevent the-poller.kqfd the-poller.ievents the-poller.oevents))))
+  (let ((n (poller-wait the-poller.os)))
     ;;(print-string (format "poller/wait-and-schedule: got " (int n) " events\n"))
-    (set! the-poller.ievents.index 0)
     (for-range
 	i n
-	(poller/enqueue-waiting-thread
-	 (get-kevent the-poller.oevents i)))
+	(let ((fd (poller-event-fd the-poller.os i))
+	      (ready (poller-event-ready the-poller.os i)))
+	  (if (not (= 0 (logand ready POLLER_READ)))
+	      (poller/enqueue-waiting-thread fd POLLER_READ))
+	  (if (not (= 0 (logand ready POLLER_WRITE)))
+	      (poller/enqueue-waiting-thread fd POLLER_WRITE))
+	  (if (not (= 0 (logand ready POLLER_DONE)))
+	      (poller/enqueue-waiting-thread fd POLLER_DONE))))
     (poller/dispatch)
     ))
-
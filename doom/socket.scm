@@ -37,6 +37,14 @@ set_nonblocking (int fd)
 (define (set-nonblocking fd)
   (%%cexp (int -> undefined) "set_nonblocking (%0)" fd))
 
+;; lets several processes listen on the same port; the kernel spreads
+;;   connections between them.
+(define (set-reuseport fd)
+  (syscall
+   (%%cexp (int -> int)
+	   "setsockopt (%0, SOL_SOCKET, SO_REUSEPORT, &(int){1}, sizeof (int))"
+	   fd)))
+
 (define (inet_pton af ascii buf)
   (syscall
    (%%cexp (int string (buffer (struct sockaddr_in)) -> int)
@@ -69,64 +77,79 @@ set_nonblocking (int fd)
    (%%cexp (int int -> int) "listen (%0, %1)" fd backlog)))
 
 (define (accept fd)
-  (let ((sockaddr (%callocate (struct sockaddr_in) 1))
-	(address-len (%callocate socklen_t 1)))
-    (%%cexp ((buffer socklen_t) -> undefined) "*%0 = sizeof(struct sockaddr_in)" address-len)
-    (let loop ()
+  (if POLLER_COMPLETIONS
+      (poller/accept fd)
+      (let ((sockaddr (%callocate (struct sockaddr_in) 1))
+	    (address-len (%callocate socklen_t 1)))
+	(%%cexp ((buffer socklen_t) -> undefined) "*%0 = sizeof(struct sockaddr_in)" address-len)
+	(let loop ()
+	  (try
+	   ;; linux doesn't pass O_NONBLOCK on to the new socket, BSD does.
+	   (let ((cfd (syscall
+		       (%%cexp (int (buffer (struct sockaddr_in)) (buffer socklen_t) -> int)
+			       "accept (%0, (struct sockaddr *) %1, %2)"
+			       fd sockaddr address-len))))
+	     (set-nonblocking cfd)
+	     cfd)
+	   except
+	   (:OSError e) -> (if (eq? e EWOULDBLOCK)
+			       (begin (poller/wait-for-read fd) (loop))
+			       (raise (:OSError e)))
+	   )))))
+
+(define (connect fd addr)
+  (if POLLER_COMPLETIONS
+      (poller/connect fd addr)
       (try
        (syscall
-	(%%cexp (int (buffer (struct sockaddr_in)) (buffer socklen_t) -> int)
-		"accept (%0, (struct sockaddr *) %1, %2)"
-		fd sockaddr address-len))
+	(%%cexp (int (buffer (struct sockaddr_in)) -> int)
+		"connect (%0, (struct sockaddr *) %1, sizeof (struct sockaddr_in))"
+		fd addr))
        except
-       (:OSError e) -> (if (eq? e EWOULDBLOCK)
-			   (begin (poller/wait-for-read fd) (loop))
+       (:OSError e) -> (if (or (eq? e EINPROGRESS)
+			       (eq? e EWOULDBLOCK))
+			   (begin (poller/wait-for-write fd) 0)
 			   (raise (:OSError e)))
-       ))))
-
-(define (connect fd addr)
-  (try
-   (syscall
-    (%%cexp (int (buffer (struct sockaddr_in)) -> int)
-	    "connect (%0, (struct sockaddr *) %1, sizeof (struct sockaddr_in))"
-	    fd addr))
-   except
-   (:OSError e) -> (if (or (eq? e EINPROGRESS)
-			   (eq? e EWOULDBLOCK))
-		       (begin (poller/wait-for-write fd) 0)
-		       (raise (:OSError e)))
-   ))
+       )))
 
 (define (recv-buffer fd buf)
-  (let loop ()
-    (try
-     (syscall
-      (%%cexp (int string int -> int)
-	      "recv (%0, %1, %2, 0)"
-	      fd buf (string-length buf)))
-     except
-     (:OSError e) -> (if (eq? e EWOULDBLOCK)
-			 (begin (poller/wait-for-read fd) (loop))
-			 (raise (:OSError e)))
-     )))
-
+  (if POLLER_COMPLETIONS
+      (poller/recv fd buf (string-length buf))
+      (let loop ()
+	(try
+	 (syscall
+	  (%%cexp (int string int -> int)
+		  "recv (%0, %1, %2, 0)"
+		  fd buf (string-length buf)))
+	 except
+	 (:OSError e) -> (if (eq? e EWOULDBLOCK)
+			     (begin (poller/wait-for-read fd) (loop))
+			     (raise (:OSError e)))
+	 ))))
+
+;; with io_uring the kernel receives into the socket's own pinned buffer
+;;   (see poller/recv-buffer), and what arrived is copied out of it.
 (define (recv fd size)
-  (let ((buffer (make-string size))
-	(r (recv-buffer fd buffer)))
-    (if (= r size)
-	buffer
-	(copy-string buffer r))))
+  (if POLLER_COMPLETIONS
+      (let ((buffer (poller/recv-buffer fd size)))
+	(copy-string buffer (poller/recv fd buffer size)))
+      (let ((buffer (make-string size))
+	    (r (recv-buffer fd buffer)))
+	(if (= r size)
+	    buffer
+	    (copy-string buffer r)))))
 
 (define (send fd s)
-  (let loop ()
-    (try
-     (syscall
-      (%%cexp (int string int -> int)
-	      "send (%0, %1, %2, 0)"
-	      fd s (string-length s)))
-     except
-     (:OSError e) -> (if (eq? e EWOULDBLOCK)
-			 (begin (poller/wait-for-write fd) (loop))
-			 (raise (:OSError e)))
-     )))
-
+  (if POLLER_COMPLETIONS
+      (poller/send fd s)
+      (let loop ()
+	(try
+	 (syscall
+	  (%%cexp (int string int -> int)
+		  "send (%0, %1, %2, 0)"
+		  fd s (string-length s)))
+	 except
+	 (:OSError e) -> (if (eq? e EWOULDBLOCK)
+			     (begin (poller/wait-for-write fd) (loop))
+			     (raise (:OSError e)))
+	 ))))
@@ -1,16 +1,485 @@
 
+// --------------------------------------------------
+// heap memory
+// --------------------------------------------------
+//
+// once gc_init() has run, heap spaces are mmap'd rather than malloc'd.  A
+//   space that holds nothing of interest (the from-space after a flip) is
+//   handed back to the OS with madvise(), which drops it from the resident
+//   set.  On linux it then reads back as zeros, so it will not need
+//   clearing when it becomes the to-space.  Since allocate() writes whole
+//   objects nobody needs the zeros by default, and MADV_FREE is used
+//   instead: the pages are only reclaimed under memory pressure, and
+//   reusing them costs no page faults.  Spaces are also marked for
+//   transparent huge pages, which makes faulting them back in cheaper.
+//
+// <sys/mman.h> only offers MAP_ANON and madvise() to strict c99 code if a
+//   feature macro was defined before the first #include (the compiler's C
+//   output does this), otherwise we fall back to malloc.
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stddef.h>
+
+#if defined(MAP_ANON) && defined(MADV_DONTNEED)
+#define PXLL_MMAP_HEAP 1
+#endif
+
+PXLL_GLOBAL int gc_mapped PXLL_INIT (0);
+
+// true if the next to-space is known to read as zeros.
+PXLL_GLOBAL int tospace_zeroed PXLL_INIT (0);
+
+// the parallel collector leaves the ends of its copy buffers unused, so a
+//   to-space may need more than <words> to hold <words> of live data.
+#define PAR_MAX_THREADS 64
+#define PAR_LAB_WORDS	4096
+
+static size_t
+gc_space_words (size_t words)
+{
+#ifdef PXLL_PARALLEL_GC
+  return words + (words / 8) + (PAR_MAX_THREADS * PAR_LAB_WORDS * 2);
+#else
+  return words;
+#endif
+}
+
+static
+object *
+gc_alloc_space (size_t words)
+{
+  words = gc_space_words (words);
+#ifdef PXLL_MMAP_HEAP
+  if (gc_mapped) {
+    void * p = mmap (NULL, sizeof (object) * words, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (p == MAP_FAILED) {
+      return NULL;
+    } else {
+#ifdef MADV_HUGEPAGE
+      madvise (p, sizeof (object) * words, MADV_HUGEPAGE);
+#endif
+      return (object *) p;
+    }
+  }
+#endif
+  return malloc (sizeof (object) * words);
+}
+
+static
+void
+gc_free_space (object * p, size_t words)
+{
+#ifdef PXLL_MMAP_HEAP
+  if (gc_mapped) {
+    if (p) {
+      munmap (p, sizeof (object) * gc_space_words (words));
+    }
+    return;
+  }
+#endif
+  free (p);
+}
+
+// returns true if the space now reads as zeros.
+static int
+gc_release_space (object * p, size_t words)
+{
+#if defined(PXLL_MMAP_HEAP) && defined(__linux__)
+  if (gc_mapped) {
+    size_t bytes = sizeof (object) * gc_space_words (words);
+#ifdef MADV_FREE
+    if (!clear_tospace && !clear_fromspace && (madvise (p, bytes, MADV_FREE) == 0)) {
+      return 0;
+    }
+#endif
+    return madvise (p, bytes, MADV_DONTNEED) == 0;
+  }
+#endif
+  return 0;
+}
+
+// --------------------------------------------------
+// mapped files
+// --------------------------------------------------
+//
+// map_file() returns the contents of a file as a read-only string that
+//   lives outside the heap.  The collectors leave pointers outside the
+//   heap alone, so the string is never copied however large it is.  The
+//   file's pages are mapped just after an anonymous page, at whose end the
+//   string's header and length are written, and an anonymous page follows
+//   them to supply the terminating zero.  Without mmap the file is read
+//   into malloc'd memory laid out the same way.  The string lasts until
+//   unmap_file().
+
+static size_t
+map_region_bytes (size_t len, size_t page)
+{
+  return page + (HOW_MANY (len, page) * page) + page;
+}
+
+// NULL, with errno set, on failure.
+static PXLL_UNUSED object *
+map_file (int fd)
+{
+  struct stat st;
+  size_t page = (size_t) sysconf (_SC_PAGESIZE);
+  size_t len;
+  char * base;
+  pxll_string * s;
+  if (fstat (fd, &st) == -1) {
+    return NULL;
+  } else if ((uintmax_t) st.st_size > UINT32_MAX) {
+    errno = EFBIG;
+    return NULL;
+  }
+  len = (size_t) st.st_size;
+#ifdef PXLL_MMAP_HEAP
+  base = mmap (NULL, map_region_bytes (len, page), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+  if (base == MAP_FAILED) {
+    return NULL;
+  }
+  if (len && mmap (base + page, len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+    int e = errno;
+    munmap (base, map_region_bytes (len, page));
+    errno = e;
+    return NULL;
+  }
+#else
+  base = calloc (map_region_bytes (len, page), 1);
+  if (!base) {
+    return NULL;
+  } else {
+    size_t got = 0;
+    while (got < len) {
+      ssize_t r = read (fd, base + page + got, len - got);
+      if (r <= 0) {
+        free (base);
+        errno = r ? errno : EIO;
+        return NULL;
+      }
+      got += r;
+    }
+  }
+#endif
+  s = (pxll_string *) (base + page - offsetof (pxll_string, data));
+  s->tc = (header) STRING_HEADER (len);
+  s->len = (uint32_t) len;
+  return (object *) s;
+}
+
+static PXLL_UNUSED object *
+unmap_file (pxll_string * s)
+{
+  size_t page = (size_t) sysconf (_SC_PAGESIZE);
+#ifdef PXLL_MMAP_HEAP
+  munmap (s->data - page, map_region_bytes (s->len, page));
+#else
+  free (s->data - page);
+#endif
+  return (object *) PXLL_UNDEFINED;
+}
+
+// --------------------------------------------------
+// large objects
+// --------------------------------------------------
+//
+// strings, buffers and packed vectors of PXLL_LARGE_WORDS words or more
+//   are not put on the heap: each gets a block of its own, which no
+//   collector ever copies.  Since they hold no pointers, a collection only
+//   needs to know which of them are still referenced.  The copy functions
+//   call large_mark() on each pointer that leads out of the space being
+//   collected.  After a collection of the whole heap, large_sweep() frees
+//   the unmarked ones.  (a minor collection doesn't sweep; the old
+//   generation may still point at them.)  <large_table> holds them all,
+//   sorted by address, so that a pointer can be looked up quickly.
+//
+// allocating as many words of large objects as the heap holds brings
+//   the next collection forward, so that garbage ones get freed even
+//   when the program does little other allocation.
+//
+// vectors still go on the heap: a large one would need the write barrier
+//   to cover memory outside the old generation.
+//
+// a pinned string (see alloc_pinned) is put here whatever its size, so
+//   that its address can be handed to the kernel for I/O that finishes
+//   after later collections.  It is freed the same way, by the first
+//   sweep to find it unreferenced.
+
+#ifndef PXLL_LARGE_WORDS
+#define PXLL_LARGE_WORDS 8192 // 64KB on 64-bit
+#endif
+
+typedef struct {
+  size_t words;		// of the whole block, header included
+  pxll_int mark;
+} large_header;
+
+#define LARGE_HEADER_WORDS	HOW_MANY (sizeof (large_header), sizeof (object))
+#define LARGE_HEADER(ob)	((large_header *) ((object *) (ob) - LARGE_HEADER_WORDS))
+
+PXLL_GLOBAL object ** large_table PXLL_INIT (NULL);
+PXLL_GLOBAL size_t large_count PXLL_INIT (0);
+PXLL_GLOBAL size_t large_table_size PXLL_INIT (0);
+// every large object lies within [large_lo, large_hi).
+PXLL_GLOBAL object * large_lo PXLL_INIT (NULL);
+PXLL_GLOBAL object * large_hi PXLL_INIT (NULL);
+// words allocated since the last sweep, counting whole pages for a mapping.
+PXLL_GLOBAL size_t large_words PXLL_INIT (0);
+// the mark given to new large objects: set while a collection that started
+//   before they were made is still marking.
+PXLL_GLOBAL pxll_int large_black PXLL_INIT (0);
+
+static object *
+large_map (size_t words)
+{
+#ifdef PXLL_MMAP_HEAP
+  if (gc_mapped) {
+    void * p = mmap (NULL, sizeof (object) * words, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    return (p == MAP_FAILED) ? NULL : (object *) p;
+  }
+#endif
+  return malloc (sizeof (object) * words);
+}
+
+// the words a block of <words> really takes: a mapping is whole pages.
+static size_t
+large_cost (size_t words)
+{
+#ifdef PXLL_MMAP_HEAP
+  if (gc_mapped) {
+    size_t page = (size_t) sysconf (_SC_PAGESIZE) / sizeof (object);
+    return HOW_MANY (words, page) * page;
+  }
+#endif
+  return words;
+}
+
+static void
+large_unmap (object * p, size_t words)
+{
+#ifdef PXLL_MMAP_HEAP
+  if (gc_mapped) {
+    munmap (p, sizeof (object) * words);
+    return;
+  }
+#endif
+  free (p);
+}
+
+// index of the first entry in <large_table> not below <ob>.
+static size_t
+large_search (object * ob)
+{
+  size_t lo = 0, hi = large_count;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (large_table[mid] < ob) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// an object of <size> words (not counting its tag) with typecode <tc>.
+static object *
+large_alloc (pxll_int tc, pxll_int size)
+{
+  size_t words = LARGE_HEADER_WORDS + size + 1;
+  object * block = large_map (words);
+  object * ob;
+  size_t i;
+  if (!block) {
+    fprintf (stderr, "unable to allocate a large object of %" PRIdPTR " words\n", size);
+    abort();
+  }
+  if (large_count == large_table_size) {
+    size_t n = large_table_size ? (large_table_size * 2) : 64;
+    object ** table = realloc (large_table, n * sizeof (object *));
+    if (!table) {
+      fprintf (stderr, "unable to allocate a large object of %" PRIdPTR " words\n", size);
+      abort();
+    }
+    large_table = table;
+    large_table_size = n;
+  }
+  ob = block + LARGE_HEADER_WORDS;
+  LARGE_HEADER (ob)->words = words;
+  LARGE_HEADER (ob)->mark = large_black;
+  *ob = (object) (size<<8 | (tc & 0xff));
+  i = large_search (ob);
+  memmove (large_table + i + 1, large_table + i, (large_count - i) * sizeof (object *));
+  large_table[i] = ob;
+  large_count++;
+  if (!large_lo || (ob < large_lo)) {
+    large_lo = ob;
+  }
+  if (ob + size + 1 > large_hi) {
+    large_hi = ob + size + 1;
+  }
+  large_words += large_cost (words);
+  if (large_words > heap_size) {
+    // fail the next heap check.
+    limit = freep;
+  }
+  return ob;
+}
+
+static PXLL_UNUSED int
+large_member (object * ob)
+{
+  size_t i;
+  if ((ob < large_lo) || (ob >= large_hi)) {
+    return 0;
+  }
+  i = large_search (ob);
+  return (i < large_count) && (large_table[i] == ob);
+}
+
+static void
+large_mark_slow (object * ob)
+{
+  size_t i = large_search (ob);
+  if ((i < large_count) && (large_table[i] == ob)) {
+    LARGE_HEADER (ob)->mark = 1;
+  }
+}
+
+// <ob> is a pointer that is not being collected.
+static inline void
+large_mark (object * ob)
+{
+  if ((ob >= large_lo) && (ob < large_hi)) {
+    large_mark_slow (ob);
+  }
+}
+
+static void
+large_unmark (void)
+{
+  size_t i;
+  for (i = 0; i < large_count; i++) {
+    LARGE_HEADER (large_table[i])->mark = 0;
+  }
+}
+
+// free the large objects left unmarked.
+static void
+large_sweep (void)
+{
+  size_t i, n = 0;
+  large_lo = large_hi = NULL;
+  for (i = 0; i < large_count; i++) {
+    object * ob = large_table[i];
+    large_header * h = LARGE_HEADER (ob);
+    if (h->mark) {
+      object * end = ob + GET_TUPLE_LENGTH (*ob) + 1;
+      large_table[n++] = ob;
+      if (!large_lo) {
+        large_lo = ob;
+      }
+      if (end > large_hi) {
+        large_hi = end;
+      }
+    } else {
+      large_unmap ((object *) h, h->words);
+    }
+  }
+  large_count = n;
+  large_words = 0;
+}
+
+// --------------------------------------------------
+// continuation stack
+// --------------------------------------------------
+//
+// compiled with PXLL_STACK_FRAMES, continuation frames (TC_SAVE objects)
+//   are pushed onto a contiguous stack rather than allocated on the heap,
+//   and popped again as they return, so most of them never cost the
+//   collector anything.  Nothing on the heap ever points into the stack:
+//   only <k> and the <next> fields of stack frames do.  That makes the
+//   stack easy to get rid of:
+//
+//   - every collection evacuates the live frames onto the heap, like any
+//     other condemned object, and empties the stack.  The backend forces a
+//     collection when a push would overflow it.
+//   - %getcc first copies the frames onto the heap (stack_promote), since a
+//     captured continuation can be stored anywhere.
+//   - %putcc can only install a captured continuation, so it empties the
+//     stack; so does returning into a heap frame.
+
+#ifdef PXLL_STACK_FRAMES
+
+#ifndef PXLL_STACK_WORDS
+#define PXLL_STACK_WORDS (1 << 17) // 1MB on 64-bit
+#endif
+
+PXLL_GLOBAL object * stack_base PXLL_INIT (NULL);
+PXLL_GLOBAL object * stack_end PXLL_INIT (NULL);
+PXLL_GLOBAL object * stack_top PXLL_INIT (NULL);
+
+#define IN_STACK(p)		(((object *) (p) >= stack_base) && ((object *) (p) < stack_end))
+#define STACK_CONDEMNED(p)	(((p) >= stack_base) && ((p) < stack_top))
+
+static int
+stack_init (void)
+{
+  stack_base = gc_alloc_space (PXLL_STACK_WORDS);
+  stack_end = stack_base + PXLL_STACK_WORDS;
+  stack_top = stack_base;
+  return stack_base != NULL;
+}
+
+// move the stack onto the heap, if it fits below <limit>.
+static PXLL_UNUSED int
+stack_promote (void)
+{
+  pxll_int n = stack_top - stack_base;
+  pxll_int delta = freep - stack_base;
+  object * p;
+  if (freep + n >= limit) {
+    return 0;
+  } else {
+    memcpy (freep, stack_base, n * sizeof (object));
+    for (p = freep; p < freep + n; p += GET_TUPLE_LENGTH (*p) + 1) {
+      if (IN_STACK (p[1])) {
+	p[1] = ((object *) p[1]) + delta;
+      }
+    }
+    if (IN_STACK (k)) {
+      k += delta;
+    }
+    freep += n;
+    stack_top = stack_base;
+    return 1;
+  }
+}
+
+#else
+#define STACK_CONDEMNED(p)	0
+#endif
+
 // --------------------------------------------------
 // cheney copying garbage collector
 // --------------------------------------------------
 
+// the end of the data in the from-space.
+PXLL_GLOBAL object * from_end;
+
+static
 int
 sitting_duck (object * p)
 {
-  return (p >= heap0) && (p < (heap0 + heap_size));
+  return ((p >= heap0) && (p < from_end)) || STACK_CONDEMNED (p);
 }
 
-static object * scan;
+PXLL_GLOBAL object * scan;
 
+static
 object *
 copy (object * p)
 {
@@ -37,16 +506,401 @@ copy (object * p)
     }
   } else {
     // pp points outside of the heap
-    //fprintf (stderr, "?");
+    large_mark (pp);
     return pp;
   }
 }
 
+#ifdef PXLL_PARALLEL_GC
+
+// --------------------------------------------------
+// parallel copying collector
+// --------------------------------------------------
+//
+// compiled in with PXLL_PARALLEL_GC (and -pthread).  IRKEN_GC_THREADS sets
+//   the number of threads, by default PXLL_GC_THREADS if that is defined,
+//   or else one per online cpu.  Collections of
+//   more than PAR_MIN_WORDS of heap are shared out between the calling
+//   thread and a pool of workers:
+//
+// * an object is claimed by swapping its header for GC_BUSY with a CAS.
+//   The winner copies it and then replaces GC_BUSY with GC_SENTINEL
+//   (the forwarding address is in word 1, as above); anyone else that
+//   reaches it spins until the sentinel appears.
+// * each thread copies into its own local allocation buffer (LAB) of
+//   PAR_LAB_WORDS, carved from the to-space with an atomic add.  Big
+//   objects get a block of their own.
+// * each thread Cheney-scans its own LAB.  When a LAB fills up, its
+//   unscanned part goes onto a shared work list, where idle threads
+//   can take it.  The collection is over when every thread is idle and
+//   the list is empty.
+//
+// The unused tail of each LAB is filled with a dummy TC_BUFFER, so the
+//   to-space can still be walked object by object.
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define GC_BUSY		(-8)
+#define PAR_BIG_WORDS	(PAR_LAB_WORDS / 16)
+#define PAR_MIN_WORDS	(1 << 20)
+
+typedef struct {
+  object * lab_top;
+  object * lab_end;
+  object * scan;	// the unscanned objects in this LAB start here
+  pthread_t thread;
+} par_worker;
+
+typedef struct {
+  object * lo;
+  object * hi;
+} par_range;
+
+PXLL_GLOBAL int par_nthreads PXLL_INIT (1);
+PXLL_GLOBAL par_worker * par_workers PXLL_INIT (NULL);
+
+// the regions being evacuated, and the to-space.
+PXLL_GLOBAL object * par_from0_lo, * par_from0_hi;
+PXLL_GLOBAL object * par_from1_lo, * par_from1_hi;
+PXLL_GLOBAL object * par_top;
+PXLL_GLOBAL object * par_end;
+
+// everything below is protected by <par_lock>.
+PXLL_GLOBAL pthread_mutex_t par_lock PXLL_INIT (PTHREAD_MUTEX_INITIALIZER);
+PXLL_GLOBAL pthread_cond_t par_work_cv PXLL_INIT (PTHREAD_COND_INITIALIZER);
+PXLL_GLOBAL pthread_cond_t par_start_cv PXLL_INIT (PTHREAD_COND_INITIALIZER);
+PXLL_GLOBAL pthread_cond_t par_done_cv PXLL_INIT (PTHREAD_COND_INITIALIZER);
+PXLL_GLOBAL par_range * par_queue PXLL_INIT (NULL);
+PXLL_GLOBAL size_t par_queue_len PXLL_INIT (0);
+PXLL_GLOBAL size_t par_queue_size PXLL_INIT (0);
+PXLL_GLOBAL int par_idle PXLL_INIT (0);
+PXLL_GLOBAL int par_finished PXLL_INIT (0);
+PXLL_GLOBAL int par_running PXLL_INIT (0);
+PXLL_GLOBAL uint64_t par_epoch PXLL_INIT (0);
+// tells the helper threads to exit.
+PXLL_GLOBAL int par_quit PXLL_INIT (0);
+
+static void
+par_overflow (void)
+{
+  fprintf (stderr, "parallel gc: to-space overflow\n");
+  abort();
+}
+
+static void
+par_push (object * lo, object * hi)
+{
+  pthread_mutex_lock (&par_lock);
+  if (par_queue_len == par_queue_size) {
+    par_queue_size = par_queue_size ? (par_queue_size * 2) : 1024;
+    par_queue = realloc (par_queue, sizeof (par_range) * par_queue_size);
+    if (!par_queue) {
+      par_overflow();
+    }
+  }
+  par_queue[par_queue_len].lo = lo;
+  par_queue[par_queue_len].hi = hi;
+  par_queue_len++;
+  pthread_cond_signal (&par_work_cv);
+  pthread_mutex_unlock (&par_lock);
+}
+
+// wait for work, returns 0 once the collection is over.
+static int
+par_take (par_range * r)
+{
+  int got = 0;
+  pthread_mutex_lock (&par_lock);
+  par_idle++;
+  while (!par_queue_len && !par_finished) {
+    if (par_idle == par_nthreads) {
+      par_finished = 1;
+      pthread_cond_broadcast (&par_work_cv);
+    } else {
+      pthread_cond_wait (&par_work_cv, &par_lock);
+    }
+  }
+  if (!par_finished) {
+    par_idle--;
+    *r = par_queue[--par_queue_len];
+    got = 1;
+  }
+  pthread_mutex_unlock (&par_lock);
+  return got;
+}
+
+static inline object *
+par_reserve (pxll_int n)
+{
+  object * addr = __atomic_fetch_add (&par_top, n * sizeof (object), __ATOMIC_RELAXED);
+  if (addr + n > par_end) {
+    par_overflow();
+  }
+  return addr;
+}
+
+static void
+par_fill (object * lo, object * hi)
+{
+  if (lo < hi) {
+    *lo = (object) (((hi - lo - 1) << 8) | TC_BUFFER);
+  }
+}
+
+static void
+par_new_lab (par_worker * w)
+{
+  par_fill (w->lab_top, w->lab_end);
+  if (w->scan < w->lab_top) {
+    par_push (w->scan, w->lab_top);
+  }
+  w->lab_top = w->scan = par_reserve (PAR_LAB_WORDS);
+  w->lab_end = w->lab_top + PAR_LAB_WORDS;
+}
+
+static inline int
+par_condemned (object * p)
+{
+  return ((p >= par_from0_lo) && (p < par_from0_hi))
+    || ((p >= par_from1_lo) && (p < par_from1_hi))
+    || STACK_CONDEMNED (p);
+}
+
+static object *
+par_copy (par_worker * w, object * p)
+{
+  object * pp = (object *) *p;
+  if (is_immediate (pp)) {
+    return pp;
+  } else if (!par_condemned (pp)) {
+    large_mark (pp);
+    return pp;
+  }
+  for (;;) {
+    object h = __atomic_load_n ((object *) pp, __ATOMIC_ACQUIRE);
+    if (h == (object) GC_SENTINEL) {
+      return (object *) pp[1];
+    } else if (h == (object) GC_BUSY) {
+      // another thread is copying it
+    } else if (__atomic_compare_exchange_n ((object *) pp, &h, (object) GC_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      pxll_int n = GET_TUPLE_LENGTH (h) + 1;
+      int big = (n > PAR_BIG_WORDS);
+      object * addr;
+      if (big) {
+        addr = par_reserve (n);
+      } else {
+        if (w->lab_top + n > w->lab_end) {
+          par_new_lab (w);
+        }
+        addr = w->lab_top;
+        w->lab_top += n;
+      }
+      addr[0] = h;
+      memcpy (addr + 1, pp + 1, sizeof (object) * (n - 1));
+      pp[1] = (object) addr;
+      __atomic_store_n ((object *) pp, (object) GC_SENTINEL, __ATOMIC_RELEASE);
+      if (big) {
+        par_push (addr, addr + n);
+      }
+      return addr;
+    }
+  }
+}
+
+// returns the address of the next object.
+static object *
+par_scan (par_worker * w, object * ob)
+{
+  pxll_int length = GET_TUPLE_LENGTH (*ob);
+  object * next = ob + length + 1;
+  object * p = ob + 1;
+  switch (GET_TYPECODE (*ob)) {
+  case TC_CLOSURE:
+    // closure = { tag, pc, lenv }
+    ob[2] = par_copy (w, ob + 2);
+    return next;
+  case TC_SAVE:
+    // save = { tag, next, lenv, pc, regs[...] }
+    ob[1] = par_copy (w, ob + 1);
+    ob[2] = par_copy (w, ob + 2);
+    p = ob + 4;
+    break;
+  case TC_STRING:
+  case TC_BUFFER:
+  case TC_VEC16:
+  case TC_FLOAT:
+  case TC_F64VEC:
+  case TC_I64VEC:
+  case TC_I32VEC:
+  case TC_U8VEC:
+    return next;
+  default:
+    break;
+  }
+  for (; p < next; p++) {
+    *p = par_copy (w, p);
+  }
+  return next;
+}
+
+static void
+par_work (par_worker * w)
+{
+  par_range r;
+  for (;;) {
+    // scan our own copies first...
+    while (w->scan < w->lab_top) {
+      object * ob = w->scan;
+      w->scan = ob + GET_TUPLE_LENGTH (*ob) + 1;
+      par_scan (w, ob);
+    }
+    // ... then help with everyone else's.
+    if (!par_take (&r)) {
+      break;
+    }
+    while (r.lo < r.hi) {
+      r.lo = par_scan (w, r.lo);
+    }
+  }
+  par_fill (w->lab_top, w->lab_end);
+}
+
+static void *
+par_thread (void * arg)
+{
+  par_worker * w = (par_worker *) arg;
+  uint64_t seen = 0;
+  for (;;) {
+    pthread_mutex_lock (&par_lock);
+    while ((par_epoch == seen) && !par_quit) {
+      pthread_cond_wait (&par_start_cv, &par_lock);
+    }
+    if (par_quit) {
+      pthread_mutex_unlock (&par_lock);
+      return NULL;
+    }
+    seen = par_epoch;
+    pthread_mutex_unlock (&par_lock);
+    w->lab_top = w->lab_end = w->scan = NULL;
+    par_work (w);
+    pthread_mutex_lock (&par_lock);
+    if (--par_running == 0) {
+      pthread_cond_signal (&par_done_cv);
+    }
+    pthread_mutex_unlock (&par_lock);
+  }
+  return NULL;
+}
+
+static void
+par_init (void)
+{
+  char * s = getenv ("IRKEN_GC_THREADS");
+#ifdef PXLL_GC_THREADS
+  long n = s ? atol (s) : PXLL_GC_THREADS;
+#else
+  long n = s ? atol (s) : sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+  int i, j;
+  par_nthreads = (n < 1) ? 1 : (n > PAR_MAX_THREADS) ? PAR_MAX_THREADS : (int) n;
+  if (par_nthreads > 1) {
+    par_workers = calloc (par_nthreads, sizeof (par_worker));
+    for (i = 1; par_workers && (i < par_nthreads); i++) {
+      if (pthread_create (&par_workers[i].thread, NULL, par_thread, &par_workers[i])) {
+        break;
+      }
+    }
+    if (!par_workers || (i < par_nthreads)) {
+      fprintf (stderr, "parallel gc: unable to start threads, collecting serially\n");
+      // stop the threads that did start.
+      pthread_mutex_lock (&par_lock);
+      par_quit = 1;
+      pthread_cond_broadcast (&par_start_cv);
+      pthread_mutex_unlock (&par_lock);
+      for (j = 1; par_workers && (j < i); j++) {
+        pthread_join (par_workers[j].thread, NULL);
+      }
+      par_nthreads = 1;
+    }
+  }
+}
+
+// is it worth collecting <used> words in parallel?
+static int
+par_wanted (size_t used)
+{
+  return (par_nthreads > 1) && (used >= PAR_MIN_WORDS);
+}
+
+// evacuate <from0> and <from1> into [to, to + size), starting with the
+//   <nroots> words at <roots>.  returns the new top of the to-space.
+static object *
+par_collect (object * roots, int nroots, object * to, size_t size)
+{
+  par_worker * w = &par_workers[0];
+  int i;
+  par_top = to;
+  par_end = to + size;
+  par_queue_len = 0;
+  par_idle = 0;
+  par_finished = 0;
+  w->lab_top = w->lab_end = w->scan = NULL;
+  par_new_lab (w);
+  for (i = 0; i < nroots; i++) {
+    roots[i] = par_copy (w, &(roots[i]));
+  }
+  pthread_mutex_lock (&par_lock);
+  par_running = par_nthreads - 1;
+  par_epoch++;
+  pthread_cond_broadcast (&par_start_cv);
+  pthread_mutex_unlock (&par_lock);
+  par_work (w);
+  pthread_mutex_lock (&par_lock);
+  while (par_running) {
+    pthread_cond_wait (&par_done_cv, &par_lock);
+  }
+  pthread_mutex_unlock (&par_lock);
+  return par_top;
+}
+
+// do_gc() into heap1, in parallel.
+static object
+par_do_gc (int nroots, size_t to_words)
+{
+  if (verbose_gc) {
+    fprintf (stderr, "[parallel gc...");
+  }
+  par_from0_lo = heap0;
+  par_from0_hi = freep;
+  par_from1_lo = par_from1_hi = NULL;
+  // the roots are already in place at the front of the to-space.
+  freep = par_collect (heap1, nroots, heap1 + nroots, gc_space_words (to_words) - nroots);
+  { object * temp = heap0; heap0 = heap1; heap1 = temp; }
+  if (verbose_gc) {
+    fprintf (stderr, "collected %" PRIuPTR " words]\n", freep - heap0);
+  }
+  return (object) box (freep - heap0);
+}
+
+#endif // PXLL_PARALLEL_GC
+
+// copy everything reachable from the <nroots> roots at the front of heap1
+//   into heap1, which has room for <to_words>, and swap the spaces.
+static
 object
-do_gc (int nroots)
+do_gc_to (int nroots, size_t to_words)
 {
   int i = 0;
 
+  from_end = freep;
+
+#ifdef PXLL_PARALLEL_GC
+  if (par_wanted (freep - heap0)) {
+    return par_do_gc (nroots, to_words);
+  }
+#endif
+
   if (verbose_gc) {
     fprintf (stderr, "[gc...");
   }
@@ -98,6 +952,11 @@ do_gc (int nroots)
       case TC_STRING:
       case TC_BUFFER:
       case TC_VEC16:
+      case TC_FLOAT:
+      case TC_F64VEC:
+      case TC_I64VEC:
+      case TC_I32VEC:
+      case TC_U8VEC:
 	// skip it all
 	scan += length + 1;
 	break;
@@ -115,57 +974,903 @@ do_gc (int nroots)
   // swap heaps
   { object * temp = heap0; heap0 = heap1; heap1 = temp; }
 
-  if (clear_fromspace) {
+  if (verbose_gc) {
+    fprintf (stderr, "collected %" PRIuPTR " words]\n", freep - heap0);
+  }
+  return (object) box (freep - heap0);
+}
+
+static
+object
+do_gc (int nroots)
+{
+  return do_gc_to (nroots, heap_size);
+}
+
+// called once the heap has settled on its size after a collection.
+static void
+gc_clear_spaces (void)
+{
+  if (clear_tospace && !tospace_zeroed && (freep < (heap0 + heap_size))) {
+    clear_space (freep, heap_size - (freep - heap0));
+  }
+  tospace_zeroed = gc_release_space (heap1, heap_size);
+  if (clear_fromspace && !tospace_zeroed) {
     // zero the from-space
     clear_space (heap1, heap_size);
   }
+}
 
-  if (clear_tospace) {
-    clear_space (freep, heap_size - (freep - heap0));
+// --------------------------------------------------
+// heap sizing
+// --------------------------------------------------
+//
+// <heap_size> starts out at the value given by the IRKEN_HEAP environment
+//   variable (if any), and after each collection is doubled while more than
+//   GC_GROW_PERCENT of it is in use, or halved (but never below the starting
+//   size) when less than GC_SHRINK_PERCENT is.  IRKEN_HEAP_MAX caps growth.
+//   Both variables are in bytes, with an optional k/m/g suffix.
+
+#define GC_GROW_PERCENT   50
+#define GC_SHRINK_PERCENT 10
+
+// returns a size in words.
+static size_t
+gc_parse_size (char * s)
+{
+  char * end;
+  size_t n = strtoull (s, &end, 10);
+  switch (*end) {
+  case 'g': case 'G': n <<= 10; // fall through
+  case 'm': case 'M': n <<= 10; // fall through
+  case 'k': case 'K': n <<= 10; break;
+  }
+  n /= sizeof (object);
+  return (n < (head_room * 4)) ? (head_room * 4) : n;
+}
+
+static void
+gc_size_from_env (void)
+{
+  char * s = getenv ("IRKEN_HEAP");
+  if (s) {
+    heap_size = heap_min = gc_parse_size (s);
+  }
+  s = getenv ("IRKEN_HEAP_MAX");
+  if (s) {
+    heap_max = gc_parse_size (s);
+  }
+}
+
+// the size the heap should be, given <live> words in use after a
+//   collection and a pending request for <need> more.
+static size_t
+gc_new_size (size_t size, size_t live, size_t need)
+{
+  size_t want = live + need + head_room;
+  size_t new_size = size;
+  while ((want * 100) > (new_size * GC_GROW_PERCENT)) {
+    new_size *= 2;
+  }
+  if ((new_size == size) && (size > heap_min) && ((want * 100) < (size * GC_SHRINK_PERCENT))) {
+    new_size = ((size / 2) < heap_min) ? heap_min : (size / 2);
+  }
+  if (heap_max && (new_size > heap_max)) {
+    new_size = (heap_max > size) ? heap_max : size;
+  }
+  return new_size;
+}
+
+// move the live data (with <nroots> roots at the front of heap0) into a
+//   new pair of semispaces of <size> words.  if they cannot be allocated
+//   the heap is left as it is.
+static PXLL_UNUSED void
+gc_resize (int nroots, size_t size)
+{
+  object * new0 = gc_alloc_space (size);
+  object * new1 = gc_alloc_space (size);
+  if (!new0 || !new1) {
+    gc_free_space (new0, size);
+    gc_free_space (new1, size);
+  } else {
+    if (verbose_gc) {
+      fprintf (stderr, "[resize heap %" PRIuPTR " -> %" PRIuPTR " words]", heap_size, size);
+    }
+    gc_free_space (heap1, heap_size);
+    heap1 = new0;
+    memcpy (heap1, heap0, sizeof (object) * nroots);
+    do_gc_to (nroots, size);
+    gc_free_space (heap1, heap_size);
+    heap1 = new1;
+    heap_size = size;
+    // new0 was fresh, so the flip left zeros above freep.
+    tospace_zeroed = gc_mapped;
+  }
+}
+
+#ifdef PXLL_GENERATIONAL
+
+// --------------------------------------------------
+// generational collector
+// --------------------------------------------------
+//
+// heap0/heap1 are two nursery buffers of <nursery_size> words, swapped on
+//   every minor collection just like the semispaces above, so the spill
+//   protocol used by the generated code (registers into heap1[3..], back
+//   out of heap0[3..]) is unchanged.  Survivors are promoted immediately
+//   (there is no aging) by bump allocation into <old_space>.  The old
+//   generation is itself a pair of <heap_size> semispaces, and is only
+//   collected (by a full copy of both generations) when it can no longer
+//   absorb the live part of the nursery.
+//
+// Pointers from old objects into the nursery are found through a card
+//   table: WRITE_BARRIER marks the card holding the updated slot, and a
+//   minor collection treats every slot in a dirty card as a root.
+//   <card_first> records the first object that starts in each card, so
+//   that a dirty card can be parsed without walking the whole generation.
+
+#define CARD_SHIFT 9 // 512-byte cards
+#define CARD_WORDS ((1 << CARD_SHIFT) / sizeof (object))
+
+PXLL_GLOBAL object * old_space PXLL_INIT (NULL);
+PXLL_GLOBAL object * old_spare PXLL_INIT (NULL);
+PXLL_GLOBAL object * old_freep PXLL_INIT (NULL);
+PXLL_GLOBAL uintptr_t old_space_bytes PXLL_INIT (0);
+PXLL_GLOBAL uint8_t * card_table PXLL_INIT (NULL);
+PXLL_GLOBAL object ** card_first PXLL_INIT (NULL);
+PXLL_GLOBAL size_t ncards PXLL_INIT (0);
+
+// the regions being evacuated: the nursery, and during a full
+//   collection the old generation as well.
+PXLL_GLOBAL object * gen_from0_lo, * gen_from0_hi;
+PXLL_GLOBAL object * gen_from1_lo, * gen_from1_hi;
+
+#ifdef PXLL_INCREMENTAL
+// see "incremental old generation" below.
+PXLL_GLOBAL int major_active PXLL_INIT (0);
+PXLL_GLOBAL uint8_t * major_cards PXLL_INIT (NULL);
+#endif
+
+static inline void
+gc_card_mark (object * slot)
+{
+  uintptr_t offset = (uintptr_t) slot - (uintptr_t) old_space;
+  if (offset < old_space_bytes) {
+    card_table[offset >> CARD_SHIFT] = 1;
+  }
+}
+
+static void
+gen_exhausted (void)
+{
+  fprintf (stderr, "heap exhausted (old generation is %" PRIuPTR " words)\n", heap_size);
+  abort();
+}
+
+static inline int
+gen_condemned (object * p)
+{
+  return ((p >= gen_from0_lo) && (p < gen_from0_hi))
+    || ((p >= gen_from1_lo) && (p < gen_from1_hi))
+    || STACK_CONDEMNED (p);
+}
+
+static object *
+gen_copy (object * p)
+{
+  object * pp = (object *) *p;
+  if (is_immediate (pp)) {
+    return pp;
+  } else if (!gen_condemned (pp)) {
+    large_mark (pp);
+    return pp;
+  } else if (*pp == (object) GC_SENTINEL) {
+    return (object *) (*(pp+1));
+  } else {
+    object * addr = old_freep;
+    pxll_int length = GET_TUPLE_LENGTH (*pp);
+    size_t card = ((uintptr_t) addr - (uintptr_t) old_space) >> CARD_SHIFT;
+    if (old_freep + length + 1 > old_space + heap_size) {
+      gen_exhausted();
+    }
+    if (!card_first[card]) {
+      card_first[card] = addr;
+    }
+    memcpy (addr, pp, sizeof (object) * (length + 1));
+    old_freep += length + 1;
+    // leave a sentinel where the tag was, followed by the forwarding address.
+    pp[0] = (object) GC_SENTINEL;
+    pp[1] = (object) addr;
+    return addr;
+  }
+}
+
+// update the pointer slots of <ob> that lie within [lo, hi), with
+//   <copy_fn>.  returns the address of the next object.
+static inline object *
+gen_scan_range (object * ob, object * lo, object * hi, object * (*copy_fn) (object *))
+{
+  pxll_int length = GET_TUPLE_LENGTH (*ob);
+  object * next = ob + length + 1;
+  object * p = ob + 1;
+  object * pc = NULL;
+  switch (GET_TYPECODE (*ob)) {
+  case TC_CLOSURE:
+    // closure = { tag, pc, lenv }
+    p = ob + 2;
+    break;
+  case TC_SAVE:
+    // save = { tag, next, lenv, pc, regs[...] }
+    pc = ob + 3;
+    break;
+  case TC_STRING:
+  case TC_BUFFER:
+  case TC_VEC16:
+  case TC_FLOAT:
+  case TC_F64VEC:
+  case TC_I64VEC:
+  case TC_I32VEC:
+  case TC_U8VEC:
+    return next;
+  default:
+    break;
+  }
+  if (p < lo) {
+    p = lo;
+  }
+  if (hi > next) {
+    hi = next;
+  }
+  for (; p < hi; p++) {
+    if (p != pc) {
+      *p = copy_fn (p);
+    }
+  }
+  return next;
+}
+
+// cheney scan of everything copied into the old generation since <scan>.
+static void
+gen_scan_from (object * scan)
+{
+  while (scan < old_freep) {
+    scan = gen_scan_range (scan, scan, old_freep, gen_copy);
+  }
+}
+
+// treat every slot in a dirty card below <old_end> as a root.
+static void
+gen_scan_cards (object * old_end)
+{
+  size_t n = HOW_MANY (old_end - old_space, CARD_WORDS);
+  size_t i, j;
+  for (i = 0; i < n; i++) {
+    if (card_table[i]) {
+      object * lo = old_space + (i * CARD_WORDS);
+      object * hi = (lo + CARD_WORDS < old_end) ? (lo + CARD_WORDS) : old_end;
+      object * ob;
+      // find the object covering the start of this card.
+      for (j = i; !card_first[j] || (card_first[j] > lo); j--) {
+        // empty body
+      }
+      for (ob = card_first[j]; ob < hi; ) {
+        object * next = ob + GET_TUPLE_LENGTH (*ob) + 1;
+        if (next > lo) {
+          gen_scan_range (ob, lo, hi, gen_copy);
+        }
+        ob = next;
+      }
+      card_table[i] = 0;
+#ifdef PXLL_INCREMENTAL
+      if (major_active) {
+        major_cards[i] = 1;
+      }
+#endif
+    }
+  }
+}
+
+// promote everything reachable in the nursery.
+static void
+gen_minor (int nroots)
+{
+  object * old_end = old_freep;
+  int i;
+  gen_from0_lo = heap0;
+  gen_from0_hi = freep;
+  gen_from1_lo = gen_from1_hi = NULL;
+  for (i = 0; i < nroots; i++) {
+    heap1[i] = gen_copy (&(heap1[i]));
+  }
+  gen_scan_cards (old_end);
+  gen_scan_from (old_end);
+}
+
+// copy both generations into the spare old semispace, resizing the old
+//   generation to <size> words.
+static void
+gen_full (int nroots, size_t size)
+{
+  int i;
+  size_t old_size = heap_size;
+  large_unmark();
+  if (size != old_size) {
+    // the spare is empty, so just replace it.
+    gc_free_space (old_spare, old_size);
+    old_spare = gc_alloc_space (size);
+    ncards = HOW_MANY (gc_space_words (size), CARD_WORDS);
+    card_table = realloc (card_table, ncards * sizeof (uint8_t));
+    card_first = realloc (card_first, ncards * sizeof (object *));
+    if (!old_spare || !card_table || !card_first) {
+      gen_exhausted();
+    }
+    heap_size = size;
+    old_space_bytes = sizeof (object) * gc_space_words (size);
+  }
+  { object * temp = old_space; old_space = old_spare; old_spare = temp; }
+  gen_from0_lo = heap0;
+  gen_from0_hi = freep;
+  gen_from1_lo = old_spare;
+  gen_from1_hi = old_freep;
+  old_freep = old_space;
+  memset (card_table, 0, ncards);
+  memset (card_first, 0, ncards * sizeof (object *));
+#ifdef PXLL_PARALLEL_GC
+  if (par_wanted ((gen_from0_hi - gen_from0_lo) + (gen_from1_hi - gen_from1_lo))) {
+    object * ob;
+    par_from0_lo = gen_from0_lo; par_from0_hi = gen_from0_hi;
+    par_from1_lo = gen_from1_lo; par_from1_hi = gen_from1_hi;
+    old_freep = par_collect (heap1, nroots, old_space, gc_space_words (heap_size));
+    // the copies were not made in address order, so find the card starts now.
+    for (ob = old_space; ob < old_freep; ob += GET_TUPLE_LENGTH (*ob) + 1) {
+      size_t card = ((uintptr_t) ob - (uintptr_t) old_space) >> CARD_SHIFT;
+      if (!card_first[card]) {
+        card_first[card] = ob;
+      }
+    }
+  } else
+#endif
+  {
+    for (i = 0; i < nroots; i++) {
+      heap1[i] = gen_copy (&(heap1[i]));
+    }
+    gen_scan_from (old_space);
+  }
+  large_sweep();
+  if (size != old_size) {
+    gc_free_space (old_spare, old_size);
+    old_spare = gc_alloc_space (size);
+    if (!old_spare) {
+      gen_exhausted();
+    }
+  } else if (!gc_release_space (old_spare, heap_size) && clear_fromspace) {
+    clear_space (old_spare, heap_size);
+  }
+}
+
+#ifdef PXLL_INCREMENTAL
+
+// --------------------------------------------------
+// incremental old generation
+// --------------------------------------------------
+//
+// With PXLL_INCREMENTAL the old generation is not collected all at once by
+//   gen_full().  Instead, once it passes <major_trigger> words, every minor
+//   collection is followed by a step of at most IRKEN_GC_PAUSE microseconds
+//   (PXLL_GC_PAUSE by default) spent copying live old objects into the
+//   spare old semispace.  A step only starts just after a minor collection,
+//   when the nursery is empty, so nothing it copies can point into it.
+//
+// This is a replicating collector: the program carries on using the
+//   originals, so they are not overwritten with forwarding addresses.
+//   Instead <major_fwd> maps each copied original (by its offset in
+//   old_space) to its replica.  A store into an original marks its card as
+//   usual, and when the minor collection clears the card it passes it on
+//   to <major_cards>.  The next step copies the slots in those cards to the
+//   replicas again.  Strings, buffers and the packed vectors are written
+//   to without a barrier, so their contents are copied once more when the
+//   cycle ends.
+//
+// When a step runs out of work the cycle ends: the roots move over to the
+//   replicas, and the two old semispaces swap.  So the longest pause is a
+//   minor collection, the copying of cards dirtied since the last step, a
+//   step, and at the end the copying of the raw objects.
+//
+// If the old generation fills up before a cycle ends, the cycle is given up
+//   and gen_full() collects it in one go.  Growing the old generation
+//   also needs gen_full().
+
+#include <time.h>
+
+#ifndef PXLL_GC_PAUSE
+#define PXLL_GC_PAUSE 1000 // microseconds
+#endif
+
+PXLL_GLOBAL uint64_t major_pause PXLL_INIT (PXLL_GC_PAUSE);
+PXLL_GLOBAL size_t major_trigger PXLL_INIT (0);
+PXLL_GLOBAL object ** major_fwd PXLL_INIT (NULL);
+PXLL_GLOBAL object ** major_first PXLL_INIT (NULL);
+PXLL_GLOBAL object * major_freep PXLL_INIT (NULL);
+PXLL_GLOBAL object * major_scan PXLL_INIT (NULL);
+// pairs of (original, replica) for objects with no pointers in them.
+PXLL_GLOBAL object ** major_raw PXLL_INIT (NULL);
+PXLL_GLOBAL size_t major_nraw PXLL_INIT (0);
+PXLL_GLOBAL size_t major_raw_size PXLL_INIT (0);
+
+static uint64_t
+major_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+// start the next cycle when half the room left after this one is gone.
+//   the room is what a minor collection can use without calling gen_full().
+static void
+major_set_trigger (void)
+{
+  size_t live = old_freep - old_space;
+  size_t room = (heap_size > (2 * nursery_size)) ? (heap_size - (2 * nursery_size)) : 0;
+  major_trigger = (room > live) ? (live + ((room - live) / 2)) : live;
+}
+
+static void
+major_stop (void)
+{
+  free (major_fwd);
+  free (major_first);
+  free (major_cards);
+  free (major_raw);
+  major_fwd = major_first = major_raw = NULL;
+  major_cards = NULL;
+  major_nraw = major_raw_size = 0;
+  major_active = 0;
+  large_black = 0;
+}
+
+static void
+major_add_raw (object * ob, object * replica)
+{
+  if (major_nraw + 2 > major_raw_size) {
+    size_t size = major_raw_size ? (major_raw_size * 2) : 1024;
+    object ** raw = realloc (major_raw, size * sizeof (object *));
+    if (!raw) {
+      gen_exhausted();
+    }
+    major_raw = raw;
+    major_raw_size = size;
   }
+  major_raw[major_nraw++] = ob;
+  major_raw[major_nraw++] = replica;
+}
 
+// the replica of what <p> points at, made if need be.
+static object *
+major_copy (object * p)
+{
+  object * pp = (object *) *p;
+  if (is_immediate (pp)) {
+    return pp;
+  } else if ((pp < old_space) || (pp >= old_freep)) {
+    large_mark (pp);
+    return pp;
+  } else if (major_fwd[pp - old_space]) {
+    return major_fwd[pp - old_space];
+  } else {
+    object * addr = major_freep;
+    pxll_int length = GET_TUPLE_LENGTH (*pp);
+    size_t card = ((uintptr_t) addr - (uintptr_t) old_spare) >> CARD_SHIFT;
+    if (major_freep + length + 1 > old_spare + heap_size) {
+      gen_exhausted();
+    }
+    if (!major_first[card]) {
+      major_first[card] = addr;
+    }
+    memcpy (addr, pp, sizeof (object) * (length + 1));
+    major_freep += length + 1;
+    major_fwd[pp - old_space] = addr;
+    switch (GET_TYPECODE (*pp)) {
+    case TC_STRING:
+    case TC_BUFFER:
+    case TC_VEC16:
+    case TC_F64VEC:
+    case TC_I64VEC:
+    case TC_I32VEC:
+    case TC_U8VEC:
+      major_add_raw (pp, addr);
+      break;
+    default:
+      break;
+    }
+    return addr;
+  }
+}
+
+// the roots are only copied now, to give the first step something to scan,
+//   and at the end: in between they change too fast to be worth it.
+static void
+major_start (int nroots)
+{
+  int i;
+  // calloc() of a big block gets fresh zero pages, and only the ones
+  //   touched cost anything.
+  major_fwd = calloc (gc_space_words (heap_size), sizeof (object *));
+  major_first = calloc (ncards, sizeof (object *));
+  major_cards = calloc (ncards, sizeof (uint8_t));
+  if (!major_fwd || !major_first || !major_cards) {
+    // no cycle: gen_full() will do the job instead.
+    major_stop();
+  } else {
+    major_freep = major_scan = old_spare;
+    major_active = 1;
+    large_unmark();
+    large_black = 1;
+    for (i = 0; i < nroots; i++) {
+      major_copy (&(heap1[i]));
+    }
+  }
+}
+
+// copy the slots in dirty cards to the replicas again.
+static void
+major_copy_cards (void)
+{
+  size_t n = HOW_MANY (old_freep - old_space, CARD_WORDS);
+  size_t i, j;
+  for (i = 0; i < n; i++) {
+    if (major_cards[i]) {
+      object * lo = old_space + (i * CARD_WORDS);
+      object * hi = (lo + CARD_WORDS < old_freep) ? (lo + CARD_WORDS) : old_freep;
+      object * ob;
+      for (j = i; !card_first[j] || (card_first[j] > lo); j--) {
+        // empty body
+      }
+      for (ob = card_first[j]; ob < hi; ) {
+        object * next = ob + GET_TUPLE_LENGTH (*ob) + 1;
+        object * replica = major_fwd[ob - old_space];
+        if (replica && (next > lo)) {
+          object * from = (ob > lo) ? ob : lo;
+          object * to = (next < hi) ? next : hi;
+          object * rlo = replica + (from - ob);
+          memcpy (rlo, from, sizeof (object) * (to - from));
+          gen_scan_range (replica, rlo, replica + (to - ob), major_copy);
+        }
+        ob = next;
+      }
+      major_cards[i] = 0;
+    }
+  }
+}
+
+// the cycle is over: make the replicas the old generation.
+static void
+major_finish (int nroots)
+{
+  size_t i;
+  object ** temp;
+  for (i = 0; i < (size_t) nroots; i++) {
+    heap1[i] = major_copy (&(heap1[i]));
+  }
+  while (major_scan < major_freep) {
+    major_scan = gen_scan_range (major_scan, major_scan, major_freep, major_copy);
+  }
+  for (i = 0; i < major_nraw; i += 2) {
+    memcpy (major_raw[i+1], major_raw[i], sizeof (object) * (GET_TUPLE_LENGTH (*major_raw[i]) + 1));
+  }
+  { object * t = old_space; old_space = old_spare; old_spare = t; }
+  temp = card_first; card_first = major_first; major_first = temp;
+  old_freep = major_freep;
+  memset (card_table, 0, ncards);
+  if (!gc_release_space (old_spare, heap_size) && clear_fromspace) {
+    clear_space (old_spare, heap_size);
+  }
+  large_sweep();
+  major_stop();
+  major_set_trigger();
   if (verbose_gc) {
-    fprintf (stderr, "collected %" PRIuPTR " words]\n", freep - heap0);
+    fprintf (stderr, "major gc done...");
   }
-  return (object) box (freep - heap0);
 }
 
-object
-gc_flip (int nregs)
+// called after each minor collection, with the roots in heap1.  with
+//   <finish> set the cycle is run to its end, however long that takes.
+static void
+major_step (int nroots, int finish)
+{
+  uint64_t deadline;
+  int n;
+  if (!major_active) {
+    if (((size_t) (old_freep - old_space) > major_trigger) || (large_words > heap_size)) {
+      major_start (nroots);
+    }
+    if (!major_active) {
+      return;
+    }
+  }
+  deadline = major_now() + major_pause;
+  major_copy_cards();
+  // look at the clock every so often.
+  for (n = 0; major_scan < major_freep; n++) {
+    major_scan = gen_scan_range (major_scan, major_scan, major_freep, major_copy);
+    if (!finish && ((n & 255) == 255) && (major_now() > deadline)) {
+      return;
+    }
+  }
+  major_finish (nroots);
+}
+
+// a full collection is taking over.
+static void
+major_abandon (void)
+{
+  if (major_active) {
+    major_stop();
+  }
+}
+
+#endif // PXLL_INCREMENTAL
+
+// collect the nursery (and the old generation too, if it cannot hold the
+//   survivors), leaving at least <nwords> free in the nursery.
+static object
+gen_flip (int nregs, pxll_int nwords)
 {
   uint64_t t0, t1;
-  object nwords;
+  int nroots = nregs + 3;
+  size_t old_used = old_freep - old_space;
+  size_t young = freep - heap0;
+  // a minor collection must leave room for the next one to promote a
+  //   whole nursery.
+  int full = (old_used + young + nursery_size) > heap_size;
+  size_t want = nroots + nwords + head_room + 1;
+#ifndef PXLL_INCREMENTAL
+  // only a full collection frees large objects.
+  full = full || (large_words > heap_size);
+#else
+  // a cycle that has fallen behind is finished off, if the survivors of
+  //   this minor collection fit: that is still less work than gen_full().
+  int finish = full && major_active && ((old_used + young) <= heap_size);
+  if (finish) {
+    full = 0;
+  }
+#endif
+  t0 = rdtsc();
+  if (verbose_gc) {
+    fprintf (stderr, full ? "[full gc..." : "[minor gc...");
+  }
+  // roots go at the front of the spare nursery buffer, as in gc_flip().
+  heap1[0] = (object) lenv;
+  heap1[1] = (object) k;
+  heap1[2] = (object) top;
+  if (full) {
+    size_t size = heap_size;
+    // only possible when the nursery has grown: make sure it will fit.
+    if ((old_used + young) > heap_size) {
+      size = gc_new_size (heap_size, old_used + young, 0);
+    }
+#ifdef PXLL_INCREMENTAL
+    major_abandon();
+#endif
+    gen_full (nroots, size);
+    size = gc_new_size (heap_size, old_freep - old_space, nursery_size);
+    if (size != heap_size) {
+      // the nursery is now empty, only the old generation needs copying.
+      freep = heap0;
+      gen_full (nroots, size);
+    }
+#ifdef PXLL_INCREMENTAL
+    major_set_trigger();
+#endif
+  } else {
+    gen_minor (nroots);
+#ifdef PXLL_INCREMENTAL
+    major_step (nroots, finish);
+#endif
+  }
+#ifdef PXLL_STACK_FRAMES
+  stack_top = stack_base;
+#endif
+  { object * temp = heap0; heap0 = heap1; heap1 = temp; }
+  lenv = (object *) heap0[0];
+  k    = (object *) heap0[1];
+  top  = (object *) heap0[2];
+  // make room for an oversized request, or go back to a cache-sized nursery.
+  if ((want > nursery_size) || ((nursery_size > nursery_default) && (want <= nursery_default))) {
+    size_t size = (want > nursery_default) ? want : nursery_default;
+    object * new0 = gc_alloc_space (size);
+    if (!new0) {
+      gen_exhausted();
+    }
+    memcpy (new0, heap0, sizeof (object) * nroots);
+    gc_free_space (heap0, nursery_size);
+    gc_free_space (heap1, nursery_size);
+    heap0 = new0;
+    heap1 = gc_alloc_space (size);
+    if (!heap1) {
+      gen_exhausted();
+    }
+    nursery_size = size;
+  }
+  freep = heap0 + nroots;
+  limit = heap0 + (nursery_size - head_room);
+  // the nursery is small and reused at once, so it is cheaper to clear it
+  //   while it is in cache than to release it.
+  if (clear_tospace) {
+    clear_space (freep, nursery_size - nroots);
+  }
+  t1 = rdtsc();
+  gc_ticks += (t1 - t0);
+  if (verbose_gc) {
+    fprintf (stderr, "old generation holds %" PRIuPTR " words]\n", old_freep - old_space);
+  }
+  return (object) box (old_freep - old_space);
+}
+
+static int
+gen_init (void)
+{
+  heap0 = gc_alloc_space (nursery_size);
+  heap1 = gc_alloc_space (nursery_size);
+  old_space = gc_alloc_space (heap_size);
+  old_spare = gc_alloc_space (heap_size);
+  ncards = HOW_MANY (gc_space_words (heap_size), CARD_WORDS);
+  card_table = calloc (ncards, sizeof (uint8_t));
+  card_first = calloc (ncards, sizeof (object *));
+  if (!heap0 || !heap1 || !old_space || !old_spare || !card_table || !card_first) {
+    return 0;
+  } else {
+    old_space_bytes = sizeof (object) * gc_space_words (heap_size);
+    old_freep = old_space;
+#ifdef PXLL_INCREMENTAL
+    {
+      char * s = getenv ("IRKEN_GC_PAUSE");
+      if (s) {
+        major_pause = strtoull (s, NULL, 10);
+      }
+      major_set_trigger();
+    }
+#endif
+    if (clear_tospace && !gc_mapped) {
+      clear_space (heap0, nursery_size);
+    }
+    limit = heap0 + (nursery_size - head_room);
+    freep = heap0;
+    return 1;
+  }
+}
+
+#endif // PXLL_GENERATIONAL
+
+// allocate the heap(s).  returns 0 on failure.
+static
+int
+gc_init (void)
+{
+  gc_size_from_env();
+#ifdef PXLL_PARALLEL_GC
+  par_init();
+#endif
+#ifdef PXLL_MMAP_HEAP
+  gc_mapped = 1;
+#endif
+#ifdef PXLL_STACK_FRAMES
+  if (!stack_init()) {
+    return 0;
+  }
+#endif
+#ifdef PXLL_GENERATIONAL
+  return gen_init();
+#else
+  heap0 = gc_alloc_space (heap_size);
+  heap1 = gc_alloc_space (heap_size);
+  if (!heap0 || !heap1) {
+    return 0;
+  } else {
+    if (!gc_mapped && clear_tospace) {
+      clear_space (heap0, heap_size);
+    }
+    // fresh mappings are already zero.
+    tospace_zeroed = gc_mapped;
+    limit = heap0 + (heap_size - head_room);
+    freep = heap0;
+    return 1;
+  }
+#endif
+}
+
+#ifndef PXLL_GENERATIONAL
+// collect, then resize the heap if needed to leave room for <nwords>.
+static object
+gc_collect (int nregs, pxll_int nwords)
+{
+  uint64_t t0, t1;
+  object nwords_live;
+  size_t size;
   t0 = rdtsc();
   // copy roots
   heap1[0] = (object) lenv;
   heap1[1] = (object) k;
   heap1[2] = (object) top;
   //assert (freep < (heap0 + heap_size));
-  nwords = do_gc (nregs + 3);
+  large_unmark();
+  nwords_live = do_gc (nregs + 3);
+#ifdef PXLL_STACK_FRAMES
+  stack_top = stack_base;
+#endif
+  size = gc_new_size (heap_size, freep - heap0, nwords);
+  if (size != heap_size) {
+    gc_resize (nregs + 3, size);
+  }
+  large_sweep();
+  gc_clear_spaces();
   // replace roots
   lenv = (object *) heap0[0];
   k    = (object *) heap0[1];
   top  = (object *) heap0[2];
   // set new limit
-  limit = heap0 + (heap_size - 1024);
+  limit = heap0 + (heap_size - head_room);
   t1 = rdtsc();
   gc_ticks += (t1 - t0);
-  return nwords;
+  return nwords_live;
+}
+#endif
+
+static
+object
+gc_flip (int nregs)
+{
+#ifdef PXLL_GENERATIONAL
+  return gen_flip (nregs, 0);
+#else
+  return gc_collect (nregs, 0);
+#endif
+}
+
+// emitted for %ensure-heap: like gc_flip(), but the caller needs
+//   <nwords> free words afterwards.
+static
+object
+gc_ensure (int nregs, pxll_int nwords)
+{
+#ifdef PXLL_GENERATIONAL
+  return gen_flip (nregs, nwords);
+#else
+  object r = gc_collect (nregs, nwords);
+  if (freep + nwords >= limit) {
+    fprintf (stderr, "heap exhausted: unable to allocate %" PRIdPTR " words\n", nwords);
+    abort();
+  }
+  return r;
+#endif
 }
 
 // XXX: do we really want to store and restore lenv/k/top?
 
 // exactly the same, except <thunk> is an extra root.
 // Warning: dump_image() knows how many roots are used here.
+static
 object *
 gc_dump (object * thunk)
 {
+#ifdef PXLL_GENERATIONAL
+  fprintf (stderr, "dump_image() is not supported by the generational collector\n");
+  abort();
+#endif
+  if (large_count) {
+    fprintf (stderr, "dump_image() cannot save large objects\n");
+    abort();
+  }
   // copy roots
   heap1[0] = (object) lenv;
   heap1[1] = (object) k;
   heap1[2] = (object) top;
   heap1[3] = (object) thunk;
   do_gc (4);
+#ifdef PXLL_STACK_FRAMES
+  stack_top = stack_base;
+#endif
+  gc_clear_spaces();
   // replace roots
   lenv  = (object *) heap0[0];
   k     = (object *) heap0[1];
@@ -177,7 +1882,7 @@ gc_dump (object * thunk)
 }
 
 
-void adjust (object * q, pxll_int delta)
+static void adjust (object * q, pxll_int delta)
 {
   if ((*q) && (!IMMEDIATE(*(q)))) {
     // get the pointer arith right
@@ -186,6 +1891,7 @@ void adjust (object * q, pxll_int delta)
   }
 }
 
+static
 void
 gc_relocate (int nroots, object * start, object * finish, pxll_int delta)
 {
@@ -225,6 +1931,11 @@ gc_relocate (int nroots, object * start, object * finish, pxll_int delta)
     case TC_STRING:
     case TC_BUFFER:
     case TC_VEC16:
+    case TC_FLOAT:
+    case TC_F64VEC:
+    case TC_I64VEC:
+    case TC_I32VEC:
+    case TC_U8VEC:
       // skip it all
       scan += length+1;
       break;
@@ -240,7 +1951,7 @@ gc_relocate (int nroots, object * start, object * finish, pxll_int delta)
 }
 
 // these could probably be written in irken...
-pxll_int dump_image (char * filename, object * closure) {
+static PXLL_UNUSED pxll_int dump_image (char * filename, object * closure) {
   FILE * dump_file = fopen (filename, "wb");
   pxll_int offset;
   pxll_int size;
@@ -260,7 +1971,7 @@ pxll_int dump_image (char * filename, object * closure) {
   return size;
 }
 
-object * load_image (char * filename) {
+static PXLL_UNUSED object * load_image (char * filename) {
   FILE * load_file = fopen (filename, "rb");
   if (!load_file) {
     abort();
@@ -270,6 +1981,19 @@ object * load_image (char * filename) {
     read_header (load_file);	// XXX verify header...
     fread (&start, sizeof(pxll_int), 1, load_file);
     fread (&size, sizeof(pxll_int), 1, load_file);
+    if ((size_t) size + head_room > heap_size) {
+      // the image came from a bigger heap.  nothing in the current one
+      //   survives the load, but our caller may still be looking at it,
+      //   so it is abandoned rather than freed.
+      size_t old_size = heap_size;
+      heap_size = gc_new_size (heap_size, size, 0);
+      gc_free_space (heap1, old_size);
+      heap1 = gc_alloc_space (heap_size);
+      if (!heap1) {
+        abort();
+      }
+      heap0 = NULL;
+    }
     fread (heap1, sizeof(pxll_int), size, load_file);
     fprintf (stderr, "size=%d\n", (int) size);
     // relocate heap0
@@ -282,6 +2006,14 @@ object * load_image (char * filename) {
     freep = heap1 + size;
     // swap heaps
     { object * temp = heap0; heap0 = heap1; heap1 = temp; }
+    if (!heap1) {
+      heap1 = gc_alloc_space (heap_size);
+      if (!heap1) {
+        abort();
+      }
+    }
+    tospace_zeroed = 0;
+    limit = heap0 + (heap_size - head_room);
     return thunk;
   }
 }
@@ -3,6 +3,23 @@
 
 static int lookup_field (int tag, int label);
 
+// the backend gives each run-time record field lookup its own cache:
+//   most sites only ever see one kind of record.
+typedef struct {
+  int tag;
+  int index;
+} field_cache;
+
+static inline int
+lookup_field_cached (int tag, int label, field_cache * c)
+{
+  if (c->tag != tag) {
+    c->index = lookup_field (tag, label);
+    c->tag = tag;
+  }
+  return c->index;
+}
+
 static
 inline
 pxll_int
@@ -91,8 +108,24 @@ indent (int n)
   }
 }
 
-void print_string (object * ob, int quoted);
-void print_list (pxll_pair * l);
+static void print_string (object * ob, int quoted);
+static void print_list (pxll_pair * l);
+
+// the shortest of %.15g/%.17g that reads back as <d>, and always
+//   recognizable as a float.  returns a static buffer.
+static char *
+float_repr (double d)
+{
+  static char buffer[32];
+  snprintf (buffer, sizeof (buffer), "%.15g", d);
+  if (strtod (buffer, NULL) != d) {
+    snprintf (buffer, sizeof (buffer), "%.17g", d);
+  }
+  if (!strpbrk (buffer, ".ein")) {
+    strcat (buffer, ".0");
+  }
+  return buffer;
+}
 
 // this is kinda lame, it's part pretty-printer, part not.
 static
@@ -214,6 +247,35 @@ dump_object (object * ob, int depth)
       case TC_SYMBOL:
 	print_string (ob[1], 0);
 	break;
+      case TC_FLOAT:
+	fprintf (stdout, "%s", float_repr (UNBOX_FLOAT (ob)));
+	break;
+      case TC_F64VEC:
+      case TC_I64VEC:
+      case TC_I32VEC:
+      case TC_U8VEC: {
+	pxll_int n = PACKED_LENGTH (ob);
+	pxll_int i;
+	switch (tc) {
+	case TC_F64VEC: fprintf (stdout, "#f64("); break;
+	case TC_I64VEC: fprintf (stdout, "#i64("); break;
+	case TC_I32VEC: fprintf (stdout, "#i32("); break;
+	default:        fprintf (stdout, "#u8("); break;
+	}
+	for (i=0; i < n; i++) {
+	  switch (tc) {
+	  case TC_F64VEC: fprintf (stdout, "%s", float_repr (PACKED_DATA (ob, double)[i])); break;
+	  case TC_I64VEC: fprintf (stdout, "%" PRId64, PACKED_DATA (ob, int64_t)[i]); break;
+	  case TC_I32VEC: fprintf (stdout, "%" PRId32, PACKED_DATA (ob, int32_t)[i]); break;
+	  default:        fprintf (stdout, "%d", PACKED_DATA (ob, uint8_t)[i]); break;
+	  }
+	  if (i < n-1) {
+	    fprintf (stdout, " ");
+	  }
+	}
+	fprintf (stdout, ")");
+      }
+	break;
       default: {
         pxll_vector * t = (pxll_vector *) ob;
         pxll_int n = get_tuple_size (ob);
@@ -238,6 +300,7 @@ dump_object (object * ob, int depth)
   return (object *) PXLL_UNDEFINED;
 }
 
+#ifndef PXLL_SPLIT_UNIT
 // for gdb...
 void
 DO (object * x)
@@ -246,8 +309,11 @@ DO (object * x)
   fprintf (stdout, "\n");
   fflush (stdout);
 }
+#endif
 
 // for debugging
+static
+PXLL_UNUSED
 void
 stack_depth_indent (object * k)
 {
@@ -257,6 +323,7 @@ stack_depth_indent (object * k)
   }
 }
 
+static
 void
 print_string (object * ob, int quoted)
 {
@@ -288,6 +355,7 @@ print_string (object * ob, int quoted)
   }
 }
 
+static
 void
 print_list (pxll_pair * l)
 {
@@ -311,6 +379,7 @@ print_list (pxll_pair * l)
   }
 }
 
+static
 int
 read_header (FILE * file)
 {
@@ -361,15 +430,15 @@ range_check (unsigned int length, unsigned int index)
 }
 #endif
 
-pxll_int verbose_gc = 1;
-pxll_int clear_fromspace = 0;
-pxll_int clear_tospace = 1;
+PXLL_GLOBAL pxll_int verbose_gc PXLL_INIT (1);
+PXLL_GLOBAL pxll_int clear_fromspace PXLL_INIT (0);
+PXLL_GLOBAL pxll_int clear_tospace PXLL_INIT (0);
 
 pxll_int vm (int argc, char * argv[]);
 
 #include "rdtsc.h"
 
-uint64_t gc_ticks = 0;
+PXLL_GLOBAL uint64_t gc_ticks PXLL_INIT (0);
 
 #if 0
 static
@@ -381,6 +450,7 @@ clear_space (object * p, pxll_int n)
   }
 }
 #else
+static
 void
 clear_space (object * p, pxll_int n)
 {
@@ -389,6 +459,40 @@ clear_space (object * p, pxll_int n)
 #endif
 
 
+// hashing for lib/hashtable.scm.  the results fit in a tagged int and
+//   are never negative.
+static inline pxll_int
+hash_int (pxll_int n)
+{
+  // the splitmix64 finalizer
+  uint64_t x = (uint64_t) n;
+  x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return (pxll_int) (x >> 2);
+}
+
+static PXLL_UNUSED pxll_int
+hash_bytes (const char * s, pxll_int n)
+{
+  // 64-bit FNV-1a, mixed to spread the low bits.
+  uint64_t h = 0xcbf29ce484222325ULL;
+  while (n--) {
+    h ^= (uint8_t) *s++;
+    h *= 0x100000001b3ULL;
+  }
+  return hash_int ((pxll_int) h);
+}
+
+// for slice-find-char in lib/string.scm: the offset of the first <ch>
+//   in the <n> bytes at <p>, or -1.
+static PXLL_UNUSED pxll_int
+find_char (const char * p, pxll_int n, int ch)
+{
+  const char * r = memchr (p, ch, n);
+  return r ? r - p : -1;
+}
+
 static object *
 varref (object * lenv, pxll_int depth, pxll_int index) {
   while (depth--) {
@@ -405,13 +509,13 @@ varset (object * lenv, pxll_int depth, pxll_int index, object * val) {
   lenv[index+2] = val;
 }
 
-static object * lenv = PXLL_NIL;
-static object * k = PXLL_NIL;
-static object * top = PXLL_NIL; // top-level (i.e. 'global') environment
-static object * t = 0; // temp - for swaps & building tuples
-static object * result;
-static object * limit; // = heap0 + (heap_size - head_room);
-static object * freep; // = heap0;
+PXLL_GLOBAL object * lenv PXLL_INIT (PXLL_NIL);
+PXLL_GLOBAL object * k PXLL_INIT (PXLL_NIL);
+PXLL_GLOBAL object * top PXLL_INIT (PXLL_NIL); // top-level (i.e. 'global') environment
+PXLL_GLOBAL object * t PXLL_INIT (0); // temp - for swaps & building tuples
+PXLL_GLOBAL object * result;
+PXLL_GLOBAL object * limit; // = heap0 + (heap_size - head_room);
+PXLL_GLOBAL object * freep; // = heap0;
 
 // REGISTER_DECLARATIONS //
 
@@ -424,7 +528,6 @@ allocate (pxll_int tc, pxll_int size)
 {
   object * save = freep;
   *freep = (object*) (size<<8 | (tc & 0xff));
-#if 0
   // at least on the g5, this technique is considerably faster than using memset
   //   in gc_flip() to 'pre-clear' the heap... probably a cache effect...
   while (size--) {
@@ -432,14 +535,11 @@ allocate (pxll_int tc, pxll_int size)
     *(++freep) = PXLL_NIL;
   }
   ++freep;
-#else
-  // if you use this version, be sure to set <clear_tospace>!
-  freep += size + 1;
-#endif
   return save;  
 }
 
-  // this is emitted by the backend for %make-tuple
+// this is emitted by the backend when every field is written before
+//   the next possible gc.
 static object *
 alloc_no_clear (pxll_int tc, pxll_int size)
 {
@@ -449,8 +549,74 @@ alloc_no_clear (pxll_int tc, pxll_int size)
   return save;  
 }
 
-static uint64_t program_start_time;
-static uint64_t program_end_time;
+static inline object *
+box_float (double d)
+{
+  object * ob = alloc_no_clear (TC_FLOAT, FLOAT_TUPLE_LENGTH);
+  UNBOX_FLOAT (ob) = d;
+  return ob;
+}
+
+// an object of <size> words that holds no pointers.  a big one goes in
+//   the large object space (see gc1.c), so the caller only has to make
+//   sure the heap has room for raw_heap_words (size).
+#define raw_heap_words(size) (((size) >= PXLL_LARGE_WORDS) ? 0 : (size))
+
+static object *
+alloc_raw (pxll_int tc, pxll_int size)
+{
+  if (size >= PXLL_LARGE_WORDS) {
+    return large_alloc (tc, size);
+  } else {
+    return alloc_no_clear (tc, size);
+  }
+}
+
+// an object that no collector will move, for a buffer the kernel may
+//   still be reading or writing after the next collection.  it takes no
+//   room on the heap.
+#define alloc_pinned(tc, size) large_alloc (tc, size)
+#define IS_PINNED(ob) large_member ((object *) (ob))
+
+// a zeroed packed vector of <n> elements of <size> bytes.  the caller
+//   has made sure the heap has room.
+static PXLL_UNUSED object *
+make_packed (pxll_int tc, pxll_int n, pxll_int size)
+{
+  object * ob = alloc_raw (tc, PACKED_TUPLE_LENGTH (n, size));
+  PACKED_LENGTH (ob) = n;
+  memset (PACKED_DATA (ob, uint8_t), 0, n * size);
+  return ob;
+}
+
+// continuation frames.  with PXLL_STACK_FRAMES they are pushed onto the
+//   continuation stack (see gc1.c), otherwise they go on the heap.  the
+//   backend emits STACK_FULL() before each push, and STACK_POP() as a
+//   frame is returned through.
+#ifdef PXLL_STACK_FRAMES
+static inline object *
+push_frame (pxll_int size)
+{
+  object * save = stack_top;
+  *stack_top = (object*) (size<<8 | TC_SAVE);
+  stack_top += size + 1;
+  return save;
+}
+#define STACK_FULL(n)	(stack_top + (n) + 1 > stack_end)
+#define STACK_USED()	(stack_top != stack_base)
+#define STACK_POP()	(stack_top = IN_STACK (k) ? k : stack_base)
+#define STACK_RESET()	(stack_top = stack_base)
+#else
+#define push_frame(n)	alloc_no_clear (TC_SAVE, n)
+#define STACK_FULL(n)	0
+#define STACK_USED()	0
+#define STACK_POP()
+#define STACK_RESET()
+#define stack_promote() 1
+#endif
+
+PXLL_GLOBAL uint64_t program_start_time;
+PXLL_GLOBAL uint64_t program_end_time;
 
 typedef void(*kfun)(void);
 static void exit_continuation (void)
@@ -462,29 +628,22 @@ static void exit_continuation (void)
   exit((int)(intptr_t)result);
 }
 
-static void toplevel (void);
-
 // XXX rename these!
-static int argc;
-static char ** argv;
+PXLL_GLOBAL int argc;
+PXLL_GLOBAL char ** argv;
 
+#ifndef PXLL_SPLIT_UNIT
+static void toplevel (void);
 
 int
 main (int _argc, char * _argv[])
 {
-  heap0 = malloc (sizeof (object) * heap_size);
-  heap1 = malloc (sizeof (object) * heap_size);
-  if (!heap0 || !heap1) {
+  if (!gc_init()) {
     fprintf (stderr, "unable to allocate heap\n");
     return -1;
   } else {
-    if (clear_tospace) {
-      clear_space (heap0, heap_size);
-    }
     argc = _argc;
     argv = _argv;
-    limit = heap0 + (heap_size - head_room);
-    freep = heap0;  
     k = allocate (TC_SAVE, 3);
     k[1] = (object *) PXLL_NIL; // top of stack
     k[2] = (object *) PXLL_NIL; // null environment
@@ -494,6 +653,7 @@ main (int _argc, char * _argv[])
     return 1;
   }
 }
+#endif
 
 
 #define PXLL_RETURN(d) result = r##d; ((kfun)(k[3]))();
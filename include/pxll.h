@@ -12,12 +12,46 @@
 typedef intptr_t pxll_int;
 typedef void * object;
 
-const size_t heap_size = 25000000; // about 200MB on 64-bit machine
+// a program compiled with -j is split over several C files, all of
+//   which include the runtime.  its functions are private to each file,
+//   but its state is defined once: in the first file (PXLL_SPLIT), and
+//   declared extern in the others (PXLL_SPLIT_UNIT too).
+#if defined (PXLL_SPLIT_UNIT)
+#define PXLL_GLOBAL extern
+#define PXLL_INIT(...)
+#elif defined (PXLL_SPLIT)
+#define PXLL_GLOBAL
+#define PXLL_INIT(...) = __VA_ARGS__
+#else
+#define PXLL_GLOBAL static
+#define PXLL_INIT(...) = __VA_ARGS__
+#endif
+
+// for the runtime functions that only some programs call: being static,
+//   they would otherwise draw -Wunused-function in the rest.
+#define PXLL_UNUSED __attribute__ ((unused))
+
+// the heap size is in words, and changes at run time: see "heap sizing" in gc1.c
+PXLL_GLOBAL size_t heap_size PXLL_INIT (1048576); // about 8MB on 64-bit machine, to start with
+PXLL_GLOBAL size_t heap_min  PXLL_INIT (1048576); // never shrink below the starting size
+PXLL_GLOBAL size_t heap_max  PXLL_INIT (0);       // no limit
 // update backend.py if you change this
-const size_t head_room = 1024;
-
-object * heap0 = NULL;
-object * heap1 = NULL;
+static const size_t head_room = 1024;
+
+// generational mode: compile with PXLL_GENERATIONAL defined (e.g. via a
+//   <cverbatim> form or the -f option) and heap0/heap1 become a pair of small
+//   nursery buffers in front of a separate old generation.  see gc1.c.
+//   PXLL_INCREMENTAL also collects the old generation a step at a time.
+#if defined(PXLL_INCREMENTAL) && !defined(PXLL_GENERATIONAL)
+#define PXLL_GENERATIONAL 1
+#endif
+#ifdef PXLL_GENERATIONAL
+static const size_t nursery_default = 262144; // about 2MB on 64-bit, cache-sized
+PXLL_GLOBAL size_t nursery_size PXLL_INIT (262144);
+#endif
+
+PXLL_GLOBAL object * heap0 PXLL_INIT (NULL);
+PXLL_GLOBAL object * heap1 PXLL_INIT (NULL);
 
 /* Type Tags */
 
@@ -42,13 +76,19 @@ object * heap1 = NULL;
 #define TC_SYMBOL               (7<<2) // 00011100  1c
 #define TC_VEC16                (8<<2) // 00100000  20
 #define TC_BUFFER               (9<<2) // 00100100  24
-#define TC_USEROBJ             (10<<2) // 00101000  28
+#define TC_FLOAT               (10<<2) // 00101000  28
+#define TC_F64VEC              (11<<2) // 00101100  2c
+#define TC_I64VEC              (12<<2) // 00110000  30
+#define TC_I32VEC              (13<<2) // 00110100  34
+#define TC_U8VEC               (14<<2) // 00111000  38
+#define TC_USEROBJ             (15<<2) // 00111100  3c
 
 // alias
 #define TC_CONTINUATION TC_SAVE
 
 // the range TC_USEROBJ to 252 is available for variant records,
-//   leaving a max of 59 variants in any one type.
+//   leaving a max of 49 variants in any one type (or polymorphic variant
+//   labels in the whole program): see max-variant-tags in self/context.scm.
 
 // immediate constants
 #define PXLL_FALSE		(object *) (0x000 | TC_BOOL)
@@ -88,6 +128,8 @@ object * heap1 = NULL;
 #define SYMBOL_HEADER           ((1<<8)|TC_SYMBOL)
 #define CONS_HEADER             ((2<<8)|TC_PAIR)
 #define VEC16_TUPLE_LENGTH(n)   HOW_MANY ((n*2) + sizeof(int32_t), sizeof(object))
+#define FLOAT_TUPLE_LENGTH      HOW_MANY (sizeof(double), sizeof(object))
+#define PACKED_TUPLE_LENGTH(n,size) (1 + HOW_MANY ((n)*(size), sizeof(object)))
 
 // these make the C output more compact & readable
 #define PXLL_TEST(x)		((x) ? PXLL_TRUE : PXLL_FALSE)
@@ -96,6 +138,16 @@ object * heap1 = NULL;
 #define UOBJ_GET(o,i)           (((pxll_vector*)(o))->val[i])
 #define UOBJ_SET(o,i,v)         (((pxll_vector*)(o))->val[i] = v)
 
+// a store of a pointer into an object that may have been promoted out of
+//   the nursery must tell the collector about it.  the backend emits
+//   PXLL_STORE for these, and a plain assignment for freshly allocated objects.
+#ifdef PXLL_GENERATIONAL
+#define WRITE_BARRIER(slot)	gc_card_mark ((object *) (slot))
+#else
+#define WRITE_BARRIER(slot)
+#endif
+#define PXLL_STORE(lval,v)	do { void ** _s = (void **) &(lval); *_s = (void *) (v); WRITE_BARRIER (_s); } while (0)
+
 // code output for literals
 #define UOTAG(n)                (TC_USEROBJ+(n<<2))
 #define UITAG(n)                (TC_USERIMM+(n<<8))
@@ -178,6 +230,25 @@ typedef struct _vec16 {
   int16_t data[];
 } pxll_vec16;
 
+// a boxed float.  the backend keeps floats in C locals where it can,
+//   and only boxes the ones that escape.
+typedef struct _float {
+  header tc;
+  double val;
+} pxll_float;
+
+#define UNBOX_FLOAT(p)		(((pxll_float *)(p))->val)
+
+// packed numeric vectors (TC_F64VEC etc.): a length, then the raw
+//   elements, which the collector never looks at.
+typedef struct _packed {
+  header tc;
+  pxll_int len;
+} pxll_packed;
+
+#define PACKED_LENGTH(p)	(((pxll_packed *)(p))->len)
+#define PACKED_DATA(p,type)	((type *)(((pxll_packed *)(p)) + 1))
+
 typedef struct _pair {
   header tc;
   object * car;
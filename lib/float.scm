@@ -0,0 +1,48 @@
+;; -*- Mode: Irken -*-
+
+;; double-precision floats.  a float is boxed on the heap, but the
+;;   backend keeps the intermediate results of inlined arithmetic in C
+;;   locals, so only the values that escape get a box.
+
+(define (int->float n)
+  (%%cexp (int -> float) "(double)%0" n))
+
+;; truncates toward zero
+(define (float->int f)
+  (%%cexp (float -> int) "(pxll_int)%0" f))
+
+(define (float+ a b)
+  (%%cexp (float float -> float) "%0+%1" a b))
+
+(define (float- a b)
+  (%%cexp (float float -> float) "%0-%1" a b))
+
+(define (float* a b)
+  (%%cexp (float float -> float) "%0*%1" a b))
+
+(define (float/ a b)
+  (%%cexp (float float -> float) "%0/%1" a b))
+
+(define (float-neg a)
+  (%%cexp (float -> float) "-%0" a))
+
+(define (float= a b)
+  (%%cexp (float float -> bool) "%0==%1" a b))
+
+(define (float< a b)
+  (%%cexp (float float -> bool) "%0<%1" a b))
+
+(define (float<= a b)
+  (%%cexp (float float -> bool) "%0<=%1" a b))
+
+(define (float> a b)
+  (%%cexp (float float -> bool) "%0>%1" a b))
+
+(define (float>= a b)
+  (%%cexp (float float -> bool) "%0>=%1" a b))
+
+(define (float-abs a)
+  (if (float< a (int->float 0)) (float-neg a) a))
+
+(define (float->string f)
+  (copy-cstring (%%cexp (float -> cstring) "float_repr (%0)" f)))
@@ -0,0 +1,163 @@
+;; -*- Mode: Irken -*-
+
+;; an open-addressing hash table using robin hood probing.
+;;
+;; The slots are three parallel vectors: the hash of each key (-1 for an
+;;   empty slot), the keys, and the values.  A key is placed as close to
+;;   its home slot (hash & mask) as it can get, and on insert a key that
+;;   is further from home than the one in the way takes its slot.  This
+;;   keeps probe sequences short and lets a failed lookup stop as soon as
+;;   it reaches a key that is closer to home than the one wanted.  Deletion
+;;   shifts the following run of keys back one slot, so there are no
+;;   tombstones.  The table doubles when it is 3/4 full.
+;;
+;; usage:
+;;   (let ((t (make-string-table)))
+;;     (t::add "x" 1)         ;; replaces any existing value
+;;     (t::get "x")           ;; => (maybe:yes 1)
+;;     (t::del "x")
+;;     (t::count)
+;;     (t::iterate (lambda (k v) ...)))
+
+;; hashing primitives, in C (see header1.c).  the results are
+;;   non-negative.
+(define (hash-int n)
+  (%%cexp (int -> int) "hash_int (%0)" n))
+
+(define (hash-string s)
+  (%%cexp (string int -> int) "hash_bytes (%0, %1)" s (string-length s)))
+
+(define (hash-symbol s)
+  (hash-int (symbol->index s)))
+
+(define (hash-table-class)
+
+  (define (distance self i h)
+    (logand (- i h) self.mask))
+
+  ;; the slot holding <k>, or -1.
+  (define (find self k)
+    (let ((h (self.hash k)))
+      (let loop ((i (logand h self.mask))
+		 (d 0))
+	(let ((h0 self.hashes[i]))
+	  (cond ((= h0 -1) -1)
+		((< (distance self i h0) d) -1)
+		((and (= h0 h) (self.eq k self.keys[i])) i)
+		(else (loop (logand (+ i 1) self.mask) (+ d 1))))))))
+
+  (define (get self k)
+    (let ((i (find self k)))
+      (if (= i -1)
+	  (maybe:no)
+	  (maybe:yes self.vals[i]))))
+
+  ;; place a key that is known not to be present.
+  (define (insert self h k v)
+    (let loop ((i (logand h self.mask))
+	       (d 0)
+	       (h h)
+	       (k k)
+	       (v v))
+      (let ((h0 self.hashes[i]))
+	(cond ((= h0 -1)
+	       (set! self.hashes[i] h)
+	       (set! self.keys[i] k)
+	       (set! self.vals[i] v))
+	      (else
+	       (let ((d0 (distance self i h0))
+		     (next (logand (+ i 1) self.mask)))
+		 (if (< d0 d)
+		     ;; the resident is closer to home: it moves on instead.
+		     (let ((k0 self.keys[i])
+			   (v0 self.vals[i]))
+		       (set! self.hashes[i] h)
+		       (set! self.keys[i] k)
+		       (set! self.vals[i] v)
+		       (loop next (+ d0 1) h0 k0 v0))
+		     (loop next (+ d 1) h k v))))))))
+
+  (define (resize self size)
+    (let ((hashes self.hashes)
+	  (keys self.keys)
+	  (vals self.vals))
+      (set! self.hashes (make-vector size -1))
+      (set! self.keys (make-vector size (magic #u)))
+      (set! self.vals (make-vector size (magic #u)))
+      (set! self.mask (- size 1))
+      (for-range
+	  i (vector-length hashes)
+	  (if (not (= hashes[i] -1))
+	      (insert self hashes[i] keys[i] vals[i])))))
+
+  (define (add self k v)
+    (let ((i (find self k)))
+      (cond ((= i -1)
+	     (let ((size (+ self.mask 1)))
+	       (if (> (* 4 (+ self.count 1)) (* 3 size))
+		   (resize self (* 2 size))))
+	     (insert self (self.hash k) k v)
+	     (set! self.count (+ self.count 1)))
+	    (else
+	     (set! self.vals[i] v)))))
+
+  (define (del self k)
+    (let ((i (find self k)))
+      (when (not (= i -1))
+	(let loop ((i i))
+	  (let ((next (logand (+ i 1) self.mask)))
+	    (let ((h0 self.hashes[next]))
+	      (cond ((or (= h0 -1) (= (distance self next h0) 0))
+		     (set! self.hashes[i] -1)
+		     (set! self.keys[i] (magic #u))
+		     (set! self.vals[i] (magic #u)))
+		    (else
+		     (set! self.hashes[i] h0)
+		     (set! self.keys[i] self.keys[next])
+		     (set! self.vals[i] self.vals[next])
+		     (loop next))))))
+	(set! self.count (- self.count 1)))))
+
+  (define (count self)
+    self.count)
+
+  (define (iterate self p)
+    (for-range
+	i (+ self.mask 1)
+	(if (not (= self.hashes[i] -1))
+	    (p self.keys[i] self.vals[i]))))
+
+  (define (keys self)
+    (let ((r '()))
+      (iterate self (lambda (k v) (PUSH r k)))
+      r))
+
+  (define (values self)
+    (let ((r '()))
+      (iterate self (lambda (k v) (PUSH r v)))
+      r))
+
+  (let ((methods
+	 {add=add
+	  get=get
+	  del=del
+	  count=count
+	  iterate=iterate
+	  keys=keys
+	  values=values}))
+    ;; new method: <hash> must agree with <eq>.
+    (lambda (hash eq)
+      {o=methods
+       hashes=(make-vector 8 -1)
+       keys=(make-vector 8 (magic #u))
+       vals=(make-vector 8 (magic #u))
+       mask=7
+       count=0
+       hash=hash
+       eq=eq})))
+
+(define hash-table-maker (hash-table-class))
+
+(define (make-string-table) (hash-table-maker hash-string string=?))
+(define (make-int-table)    (hash-table-maker hash-int =))
+(define (make-symbol-table) (hash-table-maker hash-symbol eq?))
@@ -25,9 +25,10 @@
 (define (read fd size)
   (let ((buffer (make-string size))
 	(r (syscall (%%cexp (int string int -> int) "read (%0, %1, %2)" fd buffer size))))
-    (if (= r size)
-	buffer
-	(copy-string buffer r))))
+    (cond ((= r size) buffer)
+	  ;; mostly full: trim it rather than copy it.
+	  ((>= (* 2 r) size) (string-shrink! buffer r) buffer)
+	  (else (copy-string buffer r)))))
 
 (define (read-into-buffer fd buffer)
   (syscall
@@ -44,9 +45,15 @@
   ;; XXX range check
   (syscall (%%cexp (int string int int -> int) "write (%0, %1+%2, %3)" fd s start len)))
 
+(define (write-slice fd sl)
+  (write-substring fd sl.str sl.start sl.len))
+
 (define (read-stdin)
   (read 0 1024))
 
+(define (file-exists? path)
+  (%%cexp (string -> bool) "access (%0, F_OK) == 0" (zero-terminate path)))
+
 (define (close fd)
   (syscall (%%cexp (int -> int) "close (%0)" fd)))
 
@@ -83,17 +90,56 @@
     (set! self.pos 0)
     n))
 
+;; the buffered input as a slice of the file's buffer, refilling it
+;;   first if it's empty.  the slice is only good until the next read
+;;   from <self>: take a copy (slice->string) to keep it.  an empty slice
+;;   means end of file.
+(define (file/read-slice self)
+  (when (= self.pos self.end)
+    (file/fill-buffer self)
+    #u)
+  (let ((r (make-slice self.buf self.pos (- self.end self.pos))))
+    (set! self.pos self.end)
+    r))
+
 (define (file/read-buffer self)
-  (cond ((< self.pos self.end)
-	 (let ((opos self.pos))
-	   (set! self.pos self.end)
-	   (substring self.buf opos self.end)))
-	((= (file/fill-buffer self) 0) "")
-	(else
-	 (let ((r (substring self.buf self.pos self.end)))
-	   (set! self.end 0)
-	   (set! self.pos 0)
-	   r))))
+  (slice->string (file/read-slice self)))
+
+;; the next line, without its newline, as a slice of the file's buffer
+;;   (good until the next read, as with file/read-slice).  a partial line
+;;   at the end of the buffer is moved to the front before reading more,
+;;   and the buffer doubles if a line won't fit in it.
+(define (file/read-line self)
+  (let loop ((scanned 0))
+    (let ((rest (make-slice self.buf self.pos (- self.end self.pos)))
+	  (i (slice-find-char (subslice rest scanned rest.len) #\newline)))
+      (cond ((>= i 0)
+	     (set! self.pos (+ self.pos (+ scanned (+ i 1))))
+	     (maybe:yes (subslice rest 0 (+ scanned i))))
+	    (else
+	     (let ((n rest.len)
+		   (size (string-length self.buf)))
+	       (cond ((= n size)
+		      (let ((buf (make-string (* 2 size))))
+			(buffer-copy self.buf 0 n buf 0)
+			(set! self.buf buf)))
+		     ((> self.pos 0)
+		      (%%cexp (string string int int -> undefined)
+			      "memmove (%0, %1+%2, %3)" self.buf self.buf self.pos n)))
+	       (set! self.pos 0)
+	       (set! self.end n)
+	       (let ((r (syscall
+			 (%%cexp (int string int int -> int)
+				 "read (%0, %1+%2, %3)"
+				 self.fd self.buf n (- (string-length self.buf) n)))))
+		 (cond ((> r 0)
+			(set! self.end (+ n r))
+			(loop n))
+		       ((> n 0)
+			;; the last line has no newline.
+			(set! self.pos n)
+			(maybe:yes (make-slice self.buf 0 n)))
+		       (else (maybe:no))))))))))
 
 (define (file/read-char self)
   (cond ((< self.pos self.end)
@@ -118,6 +164,28 @@
 	 (file/flush self)
 	 (file/write-char self ch))))
 
+;; the whole of the file open on <fd> as a read-only string that lives
+;;   outside the heap (see map_file in gc1.c), so the collector never
+;;   copies it.  writing to it faults.  unmap-file gives it back: nothing
+;;   may touch the string after that.
+(define (map-file fd)
+  (let ((s (%%cexp (int -> string) "map_file (%0)" fd)))
+    (if (%%cexp ((raw string) -> bool) "%0 == NULL" s)
+	(raise (:OSError (%%cexp (-> int) "errno")))
+	s)))
+
+(define (unmap-file s)
+  (%%cexp ((raw string) -> undefined) "unmap_file (%0)" s))
+
+(define (file/map path)
+  (let ((fd (open path O_RDONLY 0)))
+    (try
+     (let ((s (map-file fd)))
+       (close fd)
+       s)
+     except
+     (:OSError e) -> (begin (close fd) (raise (:OSError e))))))
+
 ;; read from a string one char at a time...
 ;; XXX think about generator interfaces...
 (define (string-reader s)
@@ -0,0 +1,76 @@
+;; -*- Mode: Irken -*-
+
+;; packed numeric vectors.  the elements are stored raw, so the
+;;   collector never has to trace them, and every access below is inlined
+;;   as a direct C load or store.
+;;
+;;   f64vec: doubles, read and written as floats (see lib/float.scm)
+;;   i64vec: int64_t
+;;   i32vec: int32_t, stores are truncated
+;;   u8vec:  uint8_t, stores are truncated
+;;
+;; the integer kinds are read and written as tagged ints, so an i64vec
+;;   element only round-trips if it fits in a pxll_int less one bit.
+
+(define (packed-words n size)
+  (+ 2 (%%cexp (int int -> int) "raw_heap_words (PACKED_TUPLE_LENGTH (%0, %1))" n size)))
+
+(define (make-f64vec n)
+  (%ensure-heap #f (packed-words n 8))
+  (%%cexp (int -> f64vec) "make_packed (TC_F64VEC, %0, sizeof (double))" n))
+
+(define (f64vec-length v)
+  (%%cexp (f64vec -> int) "PACKED_LENGTH (%0)" v))
+
+(define (f64vec-ref v i)
+  (%%cexp (f64vec int -> float)
+	  "(range_check (PACKED_LENGTH (%0), %1), PACKED_DATA (%0, double)[%1])" v i))
+
+(define (f64vec-set! v i x)
+  (%%cexp (f64vec int float -> undefined)
+	  "(range_check (PACKED_LENGTH (%0), %1), PACKED_DATA (%0, double)[%1] = %2, PXLL_UNDEFINED)" v i x))
+
+(define (make-i64vec n)
+  (%ensure-heap #f (packed-words n 8))
+  (%%cexp (int -> i64vec) "make_packed (TC_I64VEC, %0, sizeof (int64_t))" n))
+
+(define (i64vec-length v)
+  (%%cexp (i64vec -> int) "PACKED_LENGTH (%0)" v))
+
+(define (i64vec-ref v i)
+  (%%cexp (i64vec int -> int)
+	  "(range_check (PACKED_LENGTH (%0), %1), PACKED_DATA (%0, int64_t)[%1])" v i))
+
+(define (i64vec-set! v i x)
+  (%%cexp (i64vec int int -> undefined)
+	  "(range_check (PACKED_LENGTH (%0), %1), PACKED_DATA (%0, int64_t)[%1] = %2, PXLL_UNDEFINED)" v i x))
+
+(define (make-i32vec n)
+  (%ensure-heap #f (packed-words n 4))
+  (%%cexp (int -> i32vec) "make_packed (TC_I32VEC, %0, sizeof (int32_t))" n))
+
+(define (i32vec-length v)
+  (%%cexp (i32vec -> int) "PACKED_LENGTH (%0)" v))
+
+(define (i32vec-ref v i)
+  (%%cexp (i32vec int -> int)
+	  "(range_check (PACKED_LENGTH (%0), %1), PACKED_DATA (%0, int32_t)[%1])" v i))
+
+(define (i32vec-set! v i x)
+  (%%cexp (i32vec int int -> undefined)
+	  "(range_check (PACKED_LENGTH (%0), %1), PACKED_DATA (%0, int32_t)[%1] = %2, PXLL_UNDEFINED)" v i x))
+
+(define (make-u8vec n)
+  (%ensure-heap #f (packed-words n 1))
+  (%%cexp (int -> u8vec) "make_packed (TC_U8VEC, %0, 1)" n))
+
+(define (u8vec-length v)
+  (%%cexp (u8vec -> int) "PACKED_LENGTH (%0)" v))
+
+(define (u8vec-ref v i)
+  (%%cexp (u8vec int -> int)
+	  "(range_check (PACKED_LENGTH (%0), %1), PACKED_DATA (%0, uint8_t)[%1])" v i))
+
+(define (u8vec-set! v i x)
+  (%%cexp (u8vec int int -> undefined)
+	  "(range_check (PACKED_LENGTH (%0), %1), PACKED_DATA (%0, uint8_t)[%1] = %2, PXLL_UNDEFINED)" v i x))
@@ -4,12 +4,24 @@
   (%%cexp (int -> int) "string_tuple_length (%0)" n))
 
 (define (make-string n)
-  (%ensure-heap #f (string-tuple-length n))
+  (%ensure-heap #f (%%cexp (int -> int) "raw_heap_words (string_tuple_length (%0))" n))
   (%%cexp
    (int -> string)
-   "(t=alloc_no_clear (TC_STRING, string_tuple_length (%0)), ((pxll_string*)(t))->len = %0, t)"
+   "(t=alloc_raw (TC_STRING, string_tuple_length (%0)), ((pxll_string*)(t))->len = %0, t)"
    n))
 
+;; a string whose contents stay at the same address until it is freed,
+;;   so that I/O into or out of it may finish after a collection.  it is
+;;   freed by the first full collection that finds it unreferenced.
+(define (make-pinned-string n)
+  (%%cexp
+   (int -> string)
+   "(t=alloc_pinned (TC_STRING, string_tuple_length (%0)), ((pxll_string*)(t))->len = %0, t)"
+   n))
+
+(define (string-pinned? s)
+  (%%cexp ((raw string) -> bool) "IS_PINNED (%0)" s))
+
 (define (copy-string s1 n)
   (let ((s2 (make-string n)))
     (%%cexp (string string int -> undefined) "memcpy (%0, %1, %2)" s2 s1 n)
@@ -247,3 +259,64 @@
 	    "memcpy (%0, %1, %2)"
 	    result s len)
     result))
+
+;; shorten <s> to <n> characters in place.  the space past the new end
+;;   stays with the string, so only do this when most of it is in use.
+(define (string-shrink! s n)
+  (%%cexp ((raw string) int -> undefined) "range_check (((pxll_string *)(%0))->len + 1, %1)" s n)
+  (%%cexp ((raw string) int -> undefined) "((pxll_string *)(%0))->len = %1" s n))
+
+;; slices: a view of part of a string, {str start len}.  making, cutting
+;;   and comparing slices copies no characters; slice->string does.  a
+;;   slice of a buffer that is later refilled sees the new contents.
+
+(define (make-slice s start len)
+  (%%cexp ((raw string) int -> undefined) "range_check (((pxll_string *)(%0))->len + 1, %1)" s start)
+  (%%cexp ((raw string) int int -> undefined) "range_check (((pxll_string *)(%0))->len + 1 - %1, %2)" s start len)
+  {str=s start=start len=len})
+
+(define (string->slice s)
+  {str=s start=0 len=(string-length s)})
+
+(define (slice-length sl)
+  sl.len)
+
+(define (slice-ref sl i)
+  (%%cexp (int int -> undefined) "range_check (%0, %1)" sl.len i)
+  (string-ref sl.str (+ sl.start i)))
+
+;; the part of <sl> from <start> up to <end>.
+(define (subslice sl start end)
+  (%%cexp (int int -> undefined) "range_check (%0 + 1, %1)" sl.len end)
+  (%%cexp (int int -> undefined) "range_check (%0 + 1, %1)" end start)
+  {str=sl.str start=(+ sl.start start) len=(- end start)})
+
+(define (slice->string sl)
+  (substring sl.str sl.start (+ sl.start sl.len)))
+
+(define (slice-compare a b)
+  (let ((cmp (%%cexp (string int string int int -> int)
+		     "memcmp (%0+%1, %2+%3, %4)"
+		     a.str a.start b.str b.start (min a.len b.len))))
+    (cond ((= cmp 0)
+	   (if (= a.len b.len)
+	       0
+	       (if (< a.len b.len) -1 1)))
+	  (else cmp))))
+
+(define (slice=? a b)
+  (and (= a.len b.len) (= (slice-compare a b) 0)))
+
+;; the index of the first <ch> in <sl>, or -1.
+(define (slice-find-char sl ch)
+  (%%cexp (string int int char -> int) "find_char (%0+%1, %2, GET_CHAR (%3))" sl.str sl.start sl.len ch))
+
+;; the pieces of <sl> between occurrences of <ch>, as slices.
+(define (slice-split sl ch)
+  (let loop ((sl sl)
+	     (acc '()))
+    (let ((i (slice-find-char sl ch)))
+      (if (= i -1)
+	  (reverse (list:cons sl acc))
+	  (loop (subslice sl (+ i 1) sl.len)
+		(list:cons (subslice sl 0 i) acc))))))
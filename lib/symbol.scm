@@ -8,25 +8,61 @@
   (symbol:t _ index) -> index
   )
 
+;; the intern table: open addressing with linear probing, on a hash of
+;;   the symbol's name computed in C (hash_bytes() in header1.c).  Symbols
+;;   are never removed, so there are no tombstones.  A slot is empty when
+;;   its hash is -1.
+
 (define symbol-table-size 0)
-(define the-symbol-table (tree/empty))
+(define symbol-table-hashes (list->vector '(-1)))
+(define symbol-table-syms (list->vector (LIST (magic #u))))
 
-(define (intern-symbol sym)
-  (set! the-symbol-table
-	(tree/insert the-symbol-table
-		     string<?
-		     (symbol->string sym)
-		     sym))
+(define (symbol-hash str)
+  (%%cexp (string int -> int) "hash_bytes (%0, %1)" str (string-length str)))
+
+;; place a symbol known not to be in the table.
+(define (symbol-table-insert sym h)
+  (let ((mask (- (vector-length symbol-table-hashes) 1)))
+    (let loop ((i (logand h mask)))
+      (if (= symbol-table-hashes[i] -1)
+	  (begin
+	    (set! symbol-table-hashes[i] h)
+	    (set! symbol-table-syms[i] sym))
+	  (loop (logand (+ i 1) mask))))))
+
+;; make room for <n> symbols at no more than half full.
+(define (symbol-table-reserve n)
+  (when (> (* 2 n) (vector-length symbol-table-hashes))
+    (let ((hashes symbol-table-hashes)
+	  (syms symbol-table-syms)
+	  (size 16))
+      (while (< size (* 2 n))
+	(set! size (* size 2)))
+      (set! symbol-table-hashes (make-vector size -1))
+      (set! symbol-table-syms (make-vector size (magic #u)))
+      (for-range
+	  i (vector-length hashes)
+	  (if (not (= hashes[i] -1))
+	      (symbol-table-insert syms[i] hashes[i]))))))
+
+(define (intern-symbol* sym h)
+  (symbol-table-reserve (+ 1 symbol-table-size))
+  (symbol-table-insert sym h)
   (set! symbol-table-size (+ 1 symbol-table-size))
-  sym
-  )
+  sym)
+
+(define (intern-symbol sym)
+  (intern-symbol* sym (symbol-hash (symbol->string sym))))
 
 (define (string->symbol str)
-  (let ((probe (tree/member the-symbol-table string<? str)))
-    (match probe with
-      (maybe:no) -> (intern-symbol (symbol:t str symbol-table-size))
-      (maybe:yes sym) -> sym
-      )))
+  (let ((h (symbol-hash str))
+	(mask (- (vector-length symbol-table-hashes) 1)))
+    (let loop ((i (logand h mask)))
+      (let ((h0 symbol-table-hashes[i]))
+	(cond ((= h0 -1) (intern-symbol* (symbol:t str symbol-table-size) h))
+	      ((and (= h0 h) (string=? str (symbol->string symbol-table-syms[i])))
+	       symbol-table-syms[i])
+	      (else (loop (logand (+ i 1) mask))))))))
 
 (define (symbol<? s1 s2)
   (string<? (symbol->string s1) (symbol->string s2)))
@@ -36,7 +72,10 @@
 
 (define (initialize-symbol-table)
   (let ((v (%%cexp (vector symbol) "(object *) pxll_internal_symbols")))
-    (set! the-symbol-table (tree/empty)) ;; necessary because of problems with topological sort
+    (set! symbol-table-size 0) ;; necessary because of problems with topological sort
+    (set! symbol-table-hashes (list->vector '(-1)))
+    ;; these are known to be distinct, so size the table once and skip the probes.
+    (symbol-table-reserve (vector-length v))
     (let loop ((i 0))
       (if (= i (vector-length v))
 	  #u
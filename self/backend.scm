@@ -50,6 +50,37 @@
     {write=write-string indent=indent dedent=dedent copy=copy close=close-file}
     ))
 
+;; spreads the C functions written by <emit> over several writers, one
+;;   per output file: each call to split moves on to whichever has had
+;;   the least written to it so far.
+(define (make-split-writer writers)
+  (let ((sizes (make-vector (vector-length writers) 0))
+	(current 0)
+	(o writers[0]))
+    (define (write-string s)
+      (set! sizes[current] (+ sizes[current] (string-length s)))
+      (o.write s))
+    (define (split)
+      (for-range
+	  i (vector-length writers)
+	  (if (< sizes[i] sizes[current])
+	      (set! current i)))
+      (set! o writers[current]))
+    {write=write-string
+     indent=(lambda () (o.indent))
+     dedent=(lambda () (o.dedent))
+     split=split}
+    ))
+
+;; writes the same output to several writers.
+(define (make-tee-writer writers)
+  (define (write-string s)
+    (for-range
+	i (vector-length writers)
+	(let ((o writers[i]))
+	  (o.write s))))
+  {write=write-string})
+
 (define (make-name-frobber)
   (define safe-name-map
     (literal
@@ -107,12 +138,17 @@
     (type:pred name predargs _)
     -> (match name with
 	 'int	       -> (format "unbox(" arg ")")
+	 'float	       -> (format "UNBOX_FLOAT(" arg ")")
 	 'string       -> (format "((pxll_string*)(" arg "))->data")
 	 'cstring      -> (format "(char*)" arg)
 	 'buffer       -> (format "(" (irken-type->c-type type) "(((pxll_vector*)" arg ")+1))")
 	 'ptr	       -> arg
 	 'arrow	       -> arg
 	 'vector       -> arg
+	 'f64vec       -> arg
+	 'i64vec       -> arg
+	 'i32vec       -> arg
+	 'u8vec        -> arg
 	 'symbol       -> arg
 	 'char	       -> arg
 	 'continuation -> arg
@@ -147,6 +183,7 @@
 (define (wrap-out type exp)
   (match type with
     (type:pred 'int _ _)     -> (format "box((pxll_int)" exp ")")
+    (type:pred 'float _ _)   -> (format "box_float(" exp ")")
     (type:pred 'bool _ _)    -> (format "PXLL_TEST(" exp ")")
     (type:pred 'cstring _ _) -> (format "(object*)" exp)
     (type:pred 'ptr _ _)     -> (format "(object*)" exp)
@@ -189,6 +226,168 @@
      insns)
     used))
 
+;; representation selection for floats: the result of a float %%cexp is
+;;   kept in a C local, and is only boxed onto the heap if its register has
+;;   some use other than as a float argument to another %%cexp.  Any use
+;;   that could cross into another C function (a saved frame, a jump, a
+;;   spill) counts as such a use.  returns a predicate on registers that
+;;   never need the box.
+(define (find-unboxed-floats insns)
+  (let ((floats (set2-maker <))
+	(boxed (set2-maker <))
+	(aliases '()))
+    (define (box-all regs)
+      (for-each (lambda (reg) (boxed::add reg)) regs))
+    (define (cexp-args sig regs)
+      (match sig with
+	(type:pred 'arrow (_ . arg-types) _)
+	-> (for-each2
+	    (lambda (type reg)
+	      (if (not (is-pred? type 'float))
+		  (boxed::add reg)))
+	    arg-types regs)
+	_ -> (box-all regs)))
+    (walk-insns
+     (lambda (insn _)
+       (match insn with
+	 (insn:cexp sig type _ args k)
+	 -> (begin
+	      (cexp-args sig args)
+	      (if (and (is-pred? type 'float) (>= (k/target k) 0))
+		  (floats::add (k/target k))))
+	 (insn:testcexp args sig _ _ _ _ _) -> (cexp-args sig args)
+	 (insn:return reg)		    -> (boxed::add reg)
+	 (insn:test reg _ _ _ _)	    -> (boxed::add reg)
+	 (insn:jump reg _ _ free)	    -> (box-all (list:cons reg free))
+	 (insn:varset _ _ reg _)	    -> (boxed::add reg)
+	 (insn:store _ arg tup _ _)	    -> (box-all (LIST arg tup))
+	 (insn:invoke _ fun args k)	    -> (box-all (append (LIST fun args) (k/free k)))
+	 (insn:tail _ fun args)		    -> (box-all (LIST fun args))
+	 (insn:trcall _ _ args)		    -> (box-all args)
+	 (insn:push reg _)		    -> (boxed::add reg)
+	 (insn:pop reg _)		    -> (boxed::add reg)
+	 (insn:primop _ _ _ args k)	    -> (box-all (append args (k/free k)))
+	 (insn:move var src k)
+	 -> (cond ((>= src 0) (box-all (LIST var src)))
+		  ((>= (k/target k) 0) (PUSH aliases (:pair (k/target k) var))))
+	 (insn:fatbar _ _ _ _ k)	    -> (box-all (k/free k))
+	 (insn:fail _ _ free)		    -> (box-all free)
+	 (insn:nvcase reg _ _ _ _ _ _)	    -> (boxed::add reg)
+	 (insn:pvcase reg _ _ _ _ _ _)	    -> (boxed::add reg)
+	 _				    -> #u))
+     insns)
+    ;; a reference to a register variable copies it: the copy is a float
+    ;;   if the variable is, and the variable needs a box if the copy does.
+    (let loop ()
+      (let ((changed #f))
+	(for-each
+	 (lambda (alias)
+	   (match alias with
+	     (:pair copy var)
+	     -> (begin
+		  (when (and (floats::member var) (not (floats::member copy)))
+			(floats::add copy)
+			(set! changed #t))
+		  (when (and (boxed::member copy) (not (boxed::member var)))
+			(boxed::add var)
+			(set! changed #t)))))
+	 aliases)
+	(if changed (loop))))
+    (lambda (reg)
+      (and (floats::member reg) (not (boxed::member reg))))))
+
+;; heap checks: each C function tests the heap once, on entry, for as
+;;   many words as any path through it can allocate before it calls out
+;;   or returns; the allocations themselves are then bare bumps of freep.
+;;   a jump or a fail carries on into the JUMP_/FAIL_ continuation, so
+;;   the path goes on through its body too, and those continuations need
+;;   no test of their own: the only live values there are their
+;;   arguments, which would all have to be spilled.  a path also ends at
+;;   a primop that makes its own test (the size of %ensure-heap or of
+;;   %callocate is not known until run time), which then covers the rest
+;;   of the path.
+;;   continuation frames are counted as if they were on the heap, since
+;;   that is where they go without PXLL_STACK_FRAMES.
+;;   returns the counts for an insn and for a continuation.
+(define (find-heap-words insns)
+  (let ((jumps (map-maker <))
+	(fails (map-maker <))
+	(jump-memo (map-maker <))
+	(fail-memo (map-maker <)))
+
+    (define (then k n)
+      (+ n (k-words k)))
+
+    (define k-words
+      (cont:k _ _ insn) -> (words insn)
+      (cont:nil)        -> 0)
+
+    (define (max-of insns)
+      (fold (lambda (insn acc) (max (words insn) acc)) 0 insns))
+
+    (define (alts-of alts ealt)
+      (match ealt with
+	(maybe:yes ealt) -> (list:cons ealt alts)
+	(maybe:no)       -> alts))
+
+    ;; each join is reached from several places.
+    (define (join-words joins memo num)
+      (match (memo::get num) with
+	(maybe:yes n) -> n
+	(maybe:no)
+	-> (let ((n (match (joins::get num) with
+		      (maybe:yes k) -> (k-words k)
+		      (maybe:no)    -> (impossible))))
+	     (memo::add num n)
+	     n)))
+
+    (define (words insn)
+      (match insn with
+	(insn:invoke _ _ _ k)             -> (+ 4 (length (k/free k)))
+	(insn:test _ _ k0 k1 _)           -> (max-of (LIST k0 k1))
+	(insn:testcexp _ _ _ _ k0 k1 _)   -> (max-of (LIST k0 k1))
+	(insn:fatbar _ _ k0 _ _)          -> (words k0)
+	(insn:nvcase _ _ _ _ alts ealt _) -> (max-of (alts-of alts ealt))
+	(insn:pvcase _ _ _ _ alts ealt _) -> (max-of (alts-of alts ealt))
+	(insn:jump _ _ num _)             -> (join-words jumps jump-memo num)
+	(insn:fail label _ _)             -> (join-words fails fail-memo label)
+	(insn:close _ _ _ k)              -> (then k 3)
+	(insn:new-env size _ k)           -> (then k (+ size 2))
+	(insn:alloc _ size k)             -> (then k (if (> size 0) (+ size 1) 0))
+	;; a boxed float: FLOAT_TUPLE_LENGTH is at most two words.
+	(insn:cexp _ type _ _ k)          -> (then k (if (is-pred? type 'float) 3 0))
+	(insn:primop '%ensure-heap _ _ _ _) -> 0
+	(insn:primop '%callocate _ _ _ _) -> 0
+	(insn:primop '%getcc _ _ _ _)     -> 0
+	(insn:primop '%dtcon _ _ args k)  -> (then k (if (null? args) 0 (+ 1 (length args))))
+	(insn:literal _ k)                -> (then k 0)
+	(insn:litcon _ _ k)               -> (then k 0)
+	(insn:varref _ _ k)               -> (then k 0)
+	(insn:varset _ _ _ k)             -> (then k 0)
+	(insn:store _ _ _ _ k)            -> (then k 0)
+	(insn:push _ k)                   -> (then k 0)
+	(insn:pop _ k)                    -> (then k 0)
+	(insn:primop _ _ _ _ k)           -> (then k 0)
+	(insn:move _ _ k)                 -> (then k 0)
+	;; return, tail, trcall
+	_                                 -> 0
+	))
+
+    (walk-insns
+     (lambda (insn _)
+       (match insn with
+	 (insn:test _ jn _ _ k)           -> (jumps::add jn k)
+	 (insn:testcexp _ _ _ jn _ _ k)   -> (jumps::add jn k)
+	 (insn:nvcase _ _ _ jn _ _ k)     -> (jumps::add jn k)
+	 (insn:pvcase _ _ _ jn _ _ k)     -> (jumps::add jn k)
+	 (insn:fatbar label jn _ k1 k)
+	 -> (begin
+	      (jumps::add jn k)
+	      (fails::add label (cont:k -1 '() k1)))
+	 _ -> #u))
+     insns)
+    {insn=words k=k-words}))
+
 (define (emit o decls insns)
 
   (let ((fun-stack '())
@@ -196,7 +395,19 @@
 	(current-function-name 'toplevel)
 	(current-function-part (make-counter 1))
 	(used-jumps (find-jumps insns))
-	(fatbar-free (map-maker <)))
+	(fatbar-free (map-maker <))
+	(field-caches (make-counter 0))
+	(unboxed-float? (find-unboxed-floats insns))
+	(heap-words (find-heap-words insns))
+	;; when the output is split over several C files, functions may be
+	;;   called from a file other than their own.
+	(linkage (if (> the-context.options.split 1) "" "static "))
+	;; registers with an unboxed copy in a C local (f<n>) in the current
+	;;   C function.
+	(floats '())
+	;; registers holding objects allocated since the last possible gc in
+	;;   the current C function: stores into these need no write barrier.
+	(fresh '()))
 
     (define emitk
       (cont:k _ _ k) -> (emit k)
@@ -233,11 +444,19 @@
 
     ;; XXX arrange to avoid duplicates caused by jump conts
     (define (declare-static name)
-      (decls.write (format "static void " name "(void);")))
+      (decls.write (format linkage "void " name "(void);")))
 
     (define (declare  name)
       (decls.write (format "void " name "(void);")))
 
+    (define (store-string reg lval val)
+      (if (member-eq? reg fresh)
+	  (format lval " = " val ";")
+	  (format "PXLL_STORE (" lval ", " val ");")))
+
+    (define (emit-barrier-store reg lval val)
+      (o.write (store-string reg lval val)))
+
     (define (move src dst)
       (if (and (>= dst 0) (not (= src dst)))
 	  (o.write (format "O r" (int dst) " = r" (int src) ";"))))
@@ -274,9 +493,7 @@
       ;; we know we're testing a cexp, just inline it here
       (match sig with
 	(type:pred 'arrow (result-type . arg-types) _)
-	-> (let ((args0 (map (lambda (reg) (format "r" (int reg))) args))
-		 (args1 (map2 wrap-in arg-types args0))
-		 (exp (wrap-out result-type (cexp-subst template args1))))
+	-> (let ((exp (wrap-out result-type (cexp-subst template (map2 cexp-arg arg-types args)))))
 	     (push-jump-continuation k jn)
 	     (o.write (format "if PXLL_IS_TRUE(" exp ") {"))
 	     (o.indent)
@@ -299,41 +516,64 @@
 	  -> (impossible))
 	))
 
+    ;; an unboxed float is used straight from its C local.
+    (define (cexp-arg type reg)
+      (if (and (is-pred? type 'float) (member-eq? reg floats))
+	  (format "f" (int reg))
+	  (wrap-in type (format "r" (int reg)))))
+
     ;; XXX consider this: giving access to the set of free registers.
     ;;   would make it possible to do %ensure-heap in a %%cexp.
     (define (emit-cexp sig type template args target)
-      (let ((exp
-	     (match sig with
-	       (type:pred 'arrow (result-type . arg-types) _)
-	       -> (let ((args0 (map (lambda (reg) (format "r" (int reg))) args))
-			(args1 (map2 wrap-in arg-types args0)))
-		    ;; from the sig
-		    ;;(wrap-out result-type (cexp-subst template args1))
-		    ;; the solved type
-		    (wrap-out type (cexp-subst template args1))
-		    )
-	       ;; some constant type
-	       _ -> (wrap-out sig template))))
-	(if (= target -1)
-	    (o.write (format exp ";"))
-	    (o.write (format "O r" (int target) " = " exp ";")))))
+      (match sig with
+	(type:pred 'arrow (result-type . arg-types) _)
+	-> (let ((exp (cexp-subst template (map2 cexp-arg arg-types args))))
+	     ;; from the sig
+	     ;;(wrap-out result-type exp)
+	     ;; the solved type
+	     (if (and (is-pred? type 'float) (>= target 0))
+		 (begin
+		   (o.write (format "double f" (int target) " = " exp ";"))
+		   (PUSH floats target)
+		   (if (not (unboxed-float? target))
+		       (o.write (format "O r" (int target) " = box_float (f" (int target) ");"))))
+		 (emit-cexp-value (wrap-out type exp) target)))
+	;; some constant type
+	_ -> (emit-cexp-value (wrap-out sig template) target)))
+
+    (define (emit-cexp-value exp target)
+      (if (= target -1)
+	  (o.write (format exp ";"))
+	  (o.write (format "O r" (int target) " = " exp ";"))))
+
+    ;; see find-heap-words.
+    (define (emit-entry-check free words)
+      (if (> words 0)
+	  (emit-check-heap free (format (int words)))))
 
     (define (emit-check-heap free size)
+      (emit-gc-test (format "freep + " size " >= limit") free size))
+
+    ;; when <test> holds, spill <free> into tospace around a collection.
+    (define (emit-gc-test test free size)
       (let ((n (length free)))
-	(o.write (format "if (freep + " size " >= limit) {"))
+	(o.write (format "if (" test ") {"))
 	(o.indent)
 	;; copy free variables into tospace
 	(for-range
 	    i n
 	    (o.write (format "heap1[" (int (+ i 3)) "] = r" (int (nth free i)) ";")))
 	;; gc
-	(o.write (format "gc_flip (" (int n) ");"))
+	(if (string=? size "0")
+	    (o.write (format "gc_flip (" (int n) ");"))
+	    (o.write (format "gc_ensure (" (int n) ", " size ");")))
 	;; copy values back into free variables
 	(for-range
 	    i n
 	    (o.write (format "r" (int (nth free i)) " = heap0[" (int (+ i 3)) "];")))
 	(o.dedent)
 	(o.write "}")
+	(set! fresh '())
 	))
 
     (define (emit-close name nreg body target)
@@ -343,23 +583,27 @@
 	      (lambda ()
 		(set! current-function-name name)
 		(set! current-function-cname cname)
-		(o.write (format "static void " cname " (void) {"))
+		(set! fresh '())
+		(set! floats '())
+		(o.write (format linkage "void " cname " (void) {"))
 		(o.indent)
-		(if (vars-get-flag name VFLAG-ALLOCATES)
-		    ;; XXX this only works because we disabled letreg around functions
-		    (emit-check-heap '() "0"))
+		;; XXX this only works because we disabled letreg around functions
+		(emit-entry-check '() (heap-words.insn body))
 		(emit body)
 		(o.dedent)
 		(o.write "}")))
-	(o.write (format "O r" (int target) " = allocate (TC_CLOSURE, 2);"))
+	(o.write (format "O r" (int target) " = alloc_no_clear (TC_CLOSURE, 2);"))
 	(o.write (format "r" (int target) "[1] = " cname "; r" (int target) "[2] = lenv;"))
+	(PUSH fresh target)
 	))
 
     (define (push-continuation cname insn args)
       (let ((args (format (join (lambda (x) (format "O r" (int x))) ", " args))))
 	(PUSH fun-stack
 	      (lambda ()
-		(o.write (format "static void " cname "(" args ") {"))
+		(set! fresh '())
+		(set! floats '())
+		(o.write (format linkage "void " cname "(" args ") {"))
 		(o.indent)
 		(emit insn)
 		(o.dedent)
@@ -373,7 +617,7 @@
       (match (used-jumps::get jump) with
 	(maybe:yes free)
 	-> (let ((cname (format "JUMP_" (int jump))))
-	     (decls.write (format "static void " cname "(" (string-join (n-of (length free) "O") ", ") ");"))
+	     (decls.write (format linkage "void " cname "(" (string-join (n-of (length free) "O") ", ") ");"))
 	     (push-continuation (format "JUMP_" (int jump)) (k/insn cont) free)
 	     )
 	(maybe:no)
@@ -391,9 +635,9 @@
 
     (define (emit-varset d i v target)
       (if (= d -1)
-	  (o.write (format "top[" (int (+ 2 i)) "] = r" (int v) ";"))
+	  (o.write (format "PXLL_STORE (top[" (int (+ 2 i)) "], r" (int v) ");"))
 	  ;;(o.write (format "varset (lenv, " (int d) ", " (int i) ", r" (int v) ");"))
-	  (o.write (format "((object*" (repeat d "*") ") lenv) " (repeat d "[1]") "[" (int (+ i 2)) "] = r" (int v) ";"))
+	  (o.write (format "PXLL_STORE (((object*" (repeat d "*") ") lenv) " (repeat d "[1]") "[" (int (+ i 2)) "], r" (int v) ");"))
 	  )
       (when (> target 0)
 	    ;; this handles this idiom:
@@ -405,6 +649,7 @@
 
     (define (emit-new-env size top? target)
       (o.write (format "O r" (int target) " = allocate (TC_ENV, " (int (+ size 1)) ");"))
+      (PUSH fresh target)
       (if top?
 	  (o.write (format "top = r" (int target) ";"))))
 
@@ -416,10 +661,12 @@
 	(if (= size 0)
 	    ;; unit type - use an immediate
 	    (o.write (format "O r" (int target) " = (object*)" tag-string ";"))
-	    (o.write (format "O r" (int target) " = allocate (" tag-string ", " (int size) ");")))))
+	    (begin
+	      (o.write (format "O r" (int target) " = allocate (" tag-string ", " (int size) ");"))
+	      (PUSH fresh target)))))
 
     (define (emit-store off arg tup i)
-      (o.write (format "r" (int tup) "[" (int (+ 1 (+ i off))) "] = r" (int arg) ";")))
+      (emit-barrier-store tup (format "r" (int tup) "[" (int (+ 1 (+ i off))) "]") (format "r" (int arg))))
 
     (define (emit-tail name fun args)
       (let ((funcall
@@ -429,7 +676,7 @@
 				     (declare-static cname)
 				     (format cname "();")))))
 	(if (>= args 0)
-	    (o.write (format "r" (int args) "[1] = r" (int fun) "[2]; lenv = r" (int args) "; " funcall))
+	    (o.write (format (store-string args (format "r" (int args) "[1]") (format "r" (int fun) "[2]")) " lenv = r" (int args) "; " funcall))
 	    (o.write (format "lenv = r" (int fun) "[2]; " funcall))
 	    )))
 
@@ -439,8 +686,15 @@
 	    (target (k/target k))
 	    (kfun (gen-function-cname current-function-name (current-function-part.inc)))
 	    )
+	;; link the args to the function's environment before the frame is
+	;;   pushed: a stack overflow can move them.
+	(if (>= args 0)
+	    (o.write (store-string args (format "r" (int args) "[1]") (format "r" (int fun) "[2]"))))
 	;; save
-	(o.write (format "O t = allocate (TC_SAVE, " (int (+ 3 nregs)) ");"))
+	(emit-gc-test (format "STACK_FULL (" (int (+ 3 nregs)) ")")
+		      (append free (if (>= args 0) (LIST fun args) (LIST fun)))
+		      "0")
+	(o.write (format "O t = push_frame (" (int (+ 3 nregs)) ");"))
 	(let ((saves
 	       (map-range
 		   i nregs
@@ -457,22 +711,27 @@
 				       (format cfun "();")
 				       ))))
 	  (if (>= args 0)
-	      (o.write (format "r" (int args) "[1] = r" (int fun) "[2]; lenv = r" (int args) "; " funcall))
+	      (o.write (format "lenv = r" (int args) "; " funcall))
 	      (o.write (format "lenv = r" (int fun) "[2]; " funcall))))
 	;; emit a new c function to represent the continuation of the current irken function
 	(PUSH fun-stack
 	      (lambda ()
 		(set! current-function-cname kfun)
-		(o.write (format "static void " kfun " (void) {"))
+		(set! fresh '())
+		(set! floats '())
+		(o.write (format linkage "void " kfun " (void) {"))
 		(o.indent)
+		(if (>= target 0)
+		    (o.write (format "O r" (int target) " = result;")))
+		;; test the heap before restoring: the saved registers are
+		;;   still in the frame, where the collector can see them.
+		(emit-entry-check (if (>= target 0) (LIST target) '()) (heap-words.k k))
 		;; restore
 		(let ((restores
 		       (map-range
 			   i nregs
 			   (format "O r" (int (nth free i)) " = k[" (int (+ i 4)) "]"))))
-		  (o.write (format (string-join restores "; ") "; lenv = k[2]; k = k[1];")))
-		(if (>= target 0)
-		    (o.write (format "O r" (int target) " = result;")))
+		  (o.write (format (string-join restores "; ") "; lenv = k[2]; STACK_POP(); k = k[1];")))
 		(emitk k)
 		(o.dedent)
 		(o.write (format "}"))
@@ -491,13 +750,13 @@
 	    (o.write (format "lenv = ((object " (joins (n-of npop "*")) ")lenv)" (joins (n-of npop "[1]")) ";")))
 	(for-range
 	    i nargs
-	    (o.write (format "lenv[" (int (+ 2 i)) "] = r" (int (nth regs i)) ";")))
+	    (o.write (format "PXLL_STORE (lenv[" (int (+ 2 i)) "], r" (int (nth regs i)) ");")))
 	(declare-static cname)
 	(o.write (format cname "();"))
       ))
 
     (define (emit-push args)
-      (o.write (format "r" (int args) "[1] = lenv; lenv = r" (int args) ";")))
+      (o.write (format (store-string args (format "r" (int args) "[1]") "lenv") " lenv = r" (int args) ";")))
 
     (define (emit-pop src target)
       (o.write (format "lenv = lenv[1];"))
@@ -506,27 +765,36 @@
     (define (subset? a b)
       (every? (lambda (x) (member-eq? x b)) a))
 
-    (define (guess-record-type sig)
-      ;; can we disambiguate this record signature?
+    (define (guess-record-index label sig)
+      ;; can we find <label> at compile time?
       (let ((sig (map (lambda (x) ;; remove sexp wrapping
 			(match x with
 			  (sexp:symbol field) -> field
 			  _ -> (impossible))) sig))
 	    (sig (filter (lambda (x) (not (eq? x '...))) sig)))
-	(let ((candidates '()))
+	(let ((indices '()))
 	  (for-each
 	   (lambda (x)
 	     (match x with
 	       (:pair sig0 index0)
-	       -> (if (subset? sig sig0)
-		      (PUSH candidates sig0))))
+	       -> (if (and (subset? sig sig0) (member-eq? label sig0))
+		      (let ((index (index-eq label sig0)))
+			(if (not (member-eq? index indices))
+			    (PUSH indices index))))))
 	   the-context.records)
-	  (if (= 1 (length candidates))
-	      ;; unambiguous - there's only one possible match.
-	      (maybe:yes (nth candidates 0))
+	  (if (= 1 (length indices))
+	      ;; unambiguous - every possible match keeps it in the same slot.
+	      (maybe:yes (nth indices 0))
 	      ;; this sig is ambiguous given the set of known records.
 	      (maybe:no)))))
 
+    ;; a run-time lookup, through a cache private to this site.
+    (define (record-field-index rec-reg label-code)
+      (let ((cache (format "field_cache_" (int (field-caches.inc)))))
+	(decls.write (format "static field_cache " cache " = {-1, 0};"))
+	(format "lookup_field_cached((GET_TYPECODE(*r" (int rec-reg) ")-TC_USEROBJ)>>2,"
+		(int label-code) ",&" cache ")")))
+
     ;; hacks for datatypes known by the runtime
     (define (get-uotag dtname altname index)
       (match dtname altname with
@@ -561,6 +829,7 @@
 					(else
 					 (let ((trg (format "r" (int target))))
 					   (o.write (format "O " trg " = alloc_no_clear (" (get-uotag dtname altname alt.index) "," (int nargs) ");"))
+					   (PUSH fresh target)
 					   ;;(o.write (format "O t = alloc_no_clear (" (get-uotag dtname altname alt.index) "," (int nargs) ");"))
 					   (for-range
 					    i nargs
@@ -581,7 +850,8 @@
 				  (o.write (format "  O t = alloc_no_clear (TC_VECTOR, unbox(r" (int vlen) "));"))
 				  (o.write (format "  for (int i=0; i<unbox(r" (int vlen) "); i++) { t[i+1] = r" (int vval) "; }"))
 				  (o.write (format "  r" (int target) " = t;"))
-				  (o.write "}"))
+				  (o.write "}")
+				  (PUSH fresh target))
 			     _ -> (primop-error))
 	  '%array-ref -> (match args with
 			   (vec index)
@@ -593,49 +863,43 @@
 			   (vec index val)
 			   -> (begin
 				(o.write (format "range_check (GET_TUPLE_LENGTH(*(object*)r" (int vec) "), unbox(r" (int index)"));"))
-				(o.write (format "((pxll_vector*)r" (int vec) ")->val[unbox(r" (int index) ")] = r" (int val) ";"))
+				(emit-barrier-store vec (format "((pxll_vector*)r" (int vec) ")->val[unbox(r" (int index) ")]") (format "r" (int val)))
 				(when (> target 0)
 				      (o.write (format "O r" (int target) " = (object *) TC_UNDEFINED;"))))
 			   _ -> (primop-error))
 	  '%record-get -> (match parm args with
 			    (sexp:list ((sexp:symbol label) (sexp:list sig))) (rec-reg)
-			    -> (let ((label-code (lookup-label-code label)))
-				 (match (guess-record-type sig) with
-				   (maybe:yes sig0)
-				   -> (o.write (format "O r" (int target) ;; compile-time lookup
-						       " = ((pxll_vector*)r" (int rec-reg)
-						       ")->val[" (int (index-eq label sig0))
-						       "];"))
-				   (maybe:no)
-				   -> (o.write (format "O r" (int target) ;; run-time lookup
-						       " = ((pxll_vector*)r" (int rec-reg)
-						       ")->val[lookup_field((GET_TYPECODE(*r" (int rec-reg)
-						       ")-TC_USEROBJ)>>2," (int label-code)
-						       ")];"))))
+			    -> (o.write (format "O r" (int target)
+						" = ((pxll_vector*)r" (int rec-reg) ")->val["
+						(match (guess-record-index label sig) with
+						  (maybe:yes index) -> (int->string index) ;; compile-time lookup
+						  (maybe:no) -> (record-field-index rec-reg (lookup-label-code label)))
+						"];"))
 			    _ _ -> (primop-error))
-	  ;; XXX very similar to record-get, maybe some way to collapse the code?
 	  '%record-set -> (match parm args with
 			    (sexp:list ((sexp:symbol label) (sexp:list sig))) (rec-reg arg-reg)
-			    -> (let ((label-code (lookup-label-code label)))
-				 (match (guess-record-type sig) with
-				   (maybe:yes sig0)
-				   -> (o.write (format "((pxll_vector*)r" (int rec-reg) ;; compile-time lookup
-						       ")->val[" (int (index-eq label sig0))
-						       "] = r" (int arg-reg) ";"))
-				   (maybe:no)
-				   -> (o.write (format "((pxll_vector*)r" (int rec-reg) ;; run-time lookup
-						       ")->val[lookup_field((GET_TYPECODE(*r" (int rec-reg)
-						       ")-TC_USEROBJ)>>2," (int label-code)
-						       ")] = r" (int arg-reg) ";")))
+			    -> (begin
+				 (emit-barrier-store
+				  rec-reg
+				  (format "((pxll_vector*)r" (int rec-reg) ")->val["
+					  (match (guess-record-index label sig) with
+					    (maybe:yes index) -> (int->string index) ;; compile-time lookup
+					    (maybe:no) -> (record-field-index rec-reg (lookup-label-code label)))
+					  "]")
+				  (format "r" (int arg-reg)))
 				 (when (> target 0)
 				       (o.write (format "O r" (int target) " = (object *) TC_UNDEFINED;"))))
 			    _ _ -> (primop-error))
-	  '%ensure-heap -> (emit-check-heap (k/free k) (format "unbox(r" (int (car args)) ")"))
-	  '%callocate -> (let ((type (parse-type parm))) ;; gets parsed twice, convert to %%cexp?
-			   ;; XXX maybe make alloc_no_clear do an ensure_heap itself?
+	  '%ensure-heap -> (emit-check-heap (k/free k) (format "unbox(r" (int (car args)) ")+" (int (heap-words.k k))))
+	  '%callocate -> (let ((type (parse-type parm)) ;; gets parsed twice, convert to %%cexp?
+			       (words (format "HOW_MANY (sizeof (" (irken-type->c-type type)
+					      ") * unbox(r" (int (car args)) "), sizeof (object))")))
 			   (if (>= target 0)
-			       (o.write (format "O r" (int target) " = alloc_no_clear (TC_BUFFER, HOW_MANY (sizeof (" (irken-type->c-type type)
-						") * unbox(r" (int (car args)) "), sizeof (object)));"))
+			       (begin
+				 (emit-check-heap (k/free k) (format "raw_heap_words (" words ")+" (int (+ 1 (heap-words.k k)))))
+				 (o.write (format "O r" (int target) " = alloc_raw (TC_BUFFER, " words ");"))
+				 ;; the heap is no longer pre-cleared, so zero it like calloc would
+				 (o.write (format "memset (r" (int target) " + 1, 0, GET_TUPLE_LENGTH (*r" (int target) ") * sizeof (object));")))
 			       (error1 "%callocate: dead target?" type)))
 	  '%exit -> (begin
 		      (o.write (format "result=r" (int (car args)) "; exit_continuation();"))
@@ -657,11 +921,16 @@
 				 (o.write (format "O r" (int target) " = (object *) TC_UNDEFINED;"))))
 		      _ _ -> (primop-error))
 	  '%getcc -> (match args with
-		       () -> (o.write (format "O r" (int target) " = k; // %getcc"))
+		       () -> (begin
+			       ;; a captured continuation must not point into the stack.
+			       (emit-gc-test "STACK_USED() && !stack_promote()" (k/free k) "0")
+			       ;; the promoted frames may have used up the room checked on entry.
+			       (emit-entry-check (k/free k) (heap-words.k k))
+			       (o.write (format "O r" (int target) " = k; // %getcc")))
 		       _	-> (primop-error))
 	  '%putcc -> (match args with
 		       (rk rv) -> (begin
-				    (o.write (format "k = r" (int rk) "; // %putcc"))
+				    (o.write (format "k = r" (int rk) "; STACK_RESET(); // %putcc"))
 				    (move rv target))
 		       _ -> (primop-error))
 	  _ -> (primop-error))))
@@ -678,11 +947,21 @@
       (cond ((and (>= src 0) (not (= src var)))
 	     ;; from varset
 	     (o.write (format "r" (int var) " = r" (int src) "; // reg varset"))
+	     (remove-eq! var fresh)
+	     (remove-eq! var floats)
 	     (if (>= target 0)
 		 (o.write (format "O r" (int target) " = (object *) TC_UNDEFINED;"))))
 	    ((and (>= target 0) (not (= target var)))
 	     ;; from varref
-	     (o.write (format "O r" (int target) " = r" (int var) "; // reg varref")))))
+	     (when (or (member-eq? var floats) (unboxed-float? target))
+		   (o.write (format "double f" (int target) " = "
+				    (if (member-eq? var floats)
+					(format "f" (int var))
+					(format "UNBOX_FLOAT(r" (int var) ")"))
+				    ";"))
+		   (PUSH floats target))
+	     (if (not (unboxed-float? target))
+		 (o.write (format "O r" (int target) " = r" (int var) "; // reg varref"))))))
 
     ;; we emit insns for k0, which may or may not jump to fail continuation in k1
     (define (emit-fatbar label jn k0 k1 k)
@@ -700,7 +979,7 @@
 	  (maybe:yes free)
 	  -> (begin
 	       (o.write (format jname "(" (join (lambda (x) (format "r" (int x))) ", " free) ");"))
-	       (decls.write (format "static void " jname "(" (string-join (n-of (length free) "O") ", ") ");")))
+	       (decls.write (format linkage "void " jname "(" (string-join (n-of (length free) "O") ", ") ");")))
 	  (maybe:no)
 	  -> (impossible)
 	  )))
@@ -812,6 +1091,7 @@
     ;; emit the top-level insns
     (o.write "static void toplevel (void) {")
     (o.indent)
+    (emit-entry-check '() (heap-words.insn insns))
     (emit insns)
     (o.dedent)
     (o.write "}")
@@ -819,7 +1099,7 @@
     (let loop ()
       (match fun-stack with
 	() -> #u
-	_  -> (begin ((pop fun-stack)) (loop))
+	_  -> (begin (o.split) ((pop fun-stack)) (loop))
 	))
     ))
 
@@ -959,6 +1239,19 @@ static prof_dump (void)
     (o.indent)
     ))
 
+;; what the other files of a split program see of the literals defined
+;;   by emit-constructed.
+(define (emit-constructed-externs o)
+  (let ((i 0))
+    (for-each
+     (lambda (lit)
+       (match lit with
+	 (literal:string _) -> (o.write (format "extern pxll_string constructed_" (int i) ";"))
+	 _		    -> (o.write (format "extern pxll_int constructed_" (int i) "[];")))
+       (set! i (+ i 1)))
+     (reverse the-context.literals))
+    (o.write "extern pxll_int pxll_internal_symbols[];")))
+
 (define c-string-safe?
   (char-class
    (string->list
@@ -1,6 +1,8 @@
 ;; -*- Mode: Irken -*-
 
 (include "self/backend.scm")
+(include "lib/hashtable.scm")
+(include "lib/sha256.scm")
 
 (define (find-base path)
   (let ((parts (string-split path #\.))
@@ -9,12 +11,13 @@
 	(error1 "find-base" path)
 	(string-join (reverse (cdr rparts)) "."))))
 
+;; map the file and copy it once, rather than collect buffers and then
+;;   concatenate them.
 (define (read-file-contents ifile)
-  (let loop ((buf (file/read-buffer ifile))
-	     (l '()))
-    (cond ((= (string-length buf) 0) (string-concat (reverse l)))
-	  (else (loop (file/read-buffer ifile)
-		      (list:cons buf l))))))
+  (let ((m (map-file ifile.fd))
+	(r (copy-string m (string-length m))))
+    (unmap-file m)
+    r))
 
 (define sentinel0 "// REGISTER_DECLARATIONS //\n")
 (define sentinel1 "// CONSTRUCTED LITERALS //\n")
@@ -41,13 +44,176 @@
 
 (include "self/flags.scm")
 
+(define (run-cc cmd)
+  (print-string (format "system: " cmd "\n"))
+  (system cmd))
+
+;; with -j <n> the C output is split over <n> files: <base>.c and
+;;   <base>.1.c ... <base>.<n-1>.c.
+(define (split-path base i ext)
+  (if (= i 0)
+      (format base ext)
+      (format base "." (int i) ext)))
+
+;; compile each of the files in the background, then link them if they
+;;   all succeeded.
+(define (split-cc-command cc-flags base n)
+  (let ((compiles
+	 (map-range
+	     i n
+	     (format cc-flags " -c " (split-path base i ".c") " -o " (split-path base i ".o") " & p" (int i) "=$!;")))
+	(waits (map-range i n (format " wait $p" (int i) " || s=1;")))
+	(objs (string-join (map-range i n (split-path base i ".o")) " ")))
+    (format "s=0; " (string-join compiles " ") (string-concat waits)
+	    " test $s = 0 && " cc-flags " " objs " -o " base " && rm -f " objs)))
+
+;; a name for a temporary file next to <path>, unique to this process.
+(define (temp-path path)
+  (format path "." (int (%%cexp (-> int) "getpid()")) ".tmp"))
+
+;; the contents of the file at <path>, which must exist.
+(define (file-contents path)
+  (let ((file (file/open-read path))
+	(text (read-file-contents file)))
+    (file/close file)
+    text))
+
+;; if IRKEN_CACHE names a directory, compiled binaries are kept there.
+;;   the key is the text that determines the binary: the compiler's
+;;   version (cc -E output doesn't change with it), the command line and
+;;   the preprocessed C (so an edit to the runtime headers counts).  a
+;;   binary is filed under a hash of its key, with the key's SHA-256 beside
+;;   it in <hash>.key, so a hash collision is a miss rather than a wrong
+;;   binary.  output that cc has already seen is copied out of the cache
+;;   instead of recompiled.
+;; a cache entry is good if <key-path> holds <digest>.
+(define (cache-key-matches? key-path digest)
+  (and (file-exists? key-path)
+       (string=? digest (file-contents key-path))))
+
+;; write <digest> to <key-path> once the entry it vouches for is in
+;;   place: a reader that finds the key finds the entry.
+(define (write-cache-key key-path digest)
+  (let ((fd (open (temp-path key-path) (logior O_WRONLY (logior O_CREAT O_TRUNC)) 420)))
+    (write fd digest)
+    (close fd)
+    (system (format "mv " (temp-path key-path) " " key-path))
+    #u))
+
+(define (cc-cache-key cc cc-flags base paths)
+  (let ((ipath (format base ".i")))
+    (define (run-into cmd then)
+      (if (not (= 0 (system (format cmd " > " ipath))))
+	  (maybe:no)
+	  (let ((text (file-contents ipath)))
+	    (unlink ipath)
+	    (then text))))
+    (run-into
+     (format cc " --version")
+     (lambda (version)
+       (let loop ((paths paths)
+		  (texts (LIST cc-flags version)))
+	 (match paths with
+	   () -> (maybe:yes (string-join (reverse texts) "\n"))
+	   (path . paths)
+	   -> (run-into (format cc-flags " -E " path)
+			(lambda (text) (loop paths (list:cons text texts))))))))))
+
+(define (cached-cc dir cc cc-flags base paths cmd)
+  (match (cc-cache-key cc cc-flags base paths) with
+    (maybe:no) -> (run-cc cmd)
+    (maybe:yes key)
+    -> (let ((cached (format dir "/" (hex (hash-string key))))
+	     (key-path (format cached ".key"))
+	     (digest (sha256 key)))
+	 (cond ((and (file-exists? cached)
+		     (cache-key-matches? key-path digest))
+		(print-string (format "cached: " cached "\n"))
+		;; rename into place: <base> may be the running compiler.
+		(system (format "cp " cached " " (temp-path base) " && mv " (temp-path base) " " base)))
+	       (else
+		(let ((r (run-cc cmd)))
+		  (when (= r 0)
+		    (system (format "mkdir -p " dir " && cp " base " " (temp-path cached) " && mv " (temp-path cached) " " cached))
+		    (write-cache-key key-path digest))
+		  r))))))
+
 (define (invoke-cc base options)
   (let ((cc (getenv-or "CC" CC))
 	(cflags (getenv-or "CFLAGS" CFLAGS))
 	(cflags (format cflags " " (if options.optimize "-O" "") " " options.extra-cflags))
-	(cmd (format cc " " cflags " " base ".c -o " base)))
-    (print-string (format "system: " cmd "\n"))
-    (system cmd)))
+	(cc-flags (format cc " " cflags))
+	(n options.split)
+	(cmd (if (= n 1)
+		 (format cc-flags " " base ".c -o " base)
+		 (split-cc-command cc-flags base n))))
+    (match (getenv "IRKEN_CACHE") with
+      "" -> (run-cc cmd)
+      dir -> (cached-cc dir cc cc-flags base (map-range i n (split-path base i ".c")) cmd))))
+
+;; an unambiguous rendering of an s-expression, for hashing: unlike
+;;   repr, strings carry their length so quotes inside them can't
+;;   confuse two different programs.
+(define sexp-key-field
+  (field:t name val) -> (format (sym name) "=" (p sexp-key val)))
+
+(define sexp-key
+  (sexp:string s)   -> (format "\"" (int (string-length s)) ":" s)
+  (sexp:list l)     -> (format "(" (join sexp-key " " l) ")")
+  (sexp:vector v)   -> (format "#(" (join sexp-key " " v) ")")
+  (sexp:record fl)  -> (format "{" (join sexp-key-field " " fl) "}")
+  (sexp:attr lhs a) -> (format (p sexp-key lhs) "." (sym a))
+  x		    -> (repr x)
+  )
+
+;; with IRKEN_CACHE set, the C output is cached as well as the binary.
+;;   the key covers everything the C depends on: the program's forms
+;;   (includes and standard macros and all), the options that change
+;;   code generation, the runtime header, and the compiler itself.
+;;   returns the path prefix of the cached files, which are good only if
+;;   <path>.key holds <digest> (as for binaries, see cached-cc).
+(define (output-cache-key forms options)
+  (let ((exe (if (file-exists? "/proc/self/exe") "/proc/self/exe" sys.argv[0])))
+    (match (getenv "IRKEN_CACHE") with
+      "" -> (maybe:no)
+      dir
+      -> (if (not (file-exists? exe))
+	     (maybe:no)
+	     (let ((header (find-file options.include-dirs "include/header1.c"))
+		   (parts (LIST (sha256 (sexp-key (sexp:list forms)))
+				(sha256 (read-file-contents header))
+				(sha256 (file-contents exe))
+				(format (bool options.trace) (bool options.profile) (bool options.noinline)
+					(bool options.noletreg) (int options.split))))
+		   (key (string-join parts " ")))
+	       (file/close header)
+	       (maybe:yes {path=(format dir "/" (hex (hash-string key)) ".out")
+			   digest=(sha256 key)}))))))
+
+;; copy the C output for <base> out of the cache, if it's there.
+(define (restore-output cached base n)
+  (if (and (every? file-exists? (map-range i n (split-path cached.path i ".c")))
+	   (cache-key-matches? (format cached.path ".key") cached.digest))
+      (begin
+	(for-range
+	    i n
+	    (print-string (format "cached: " (split-path cached.path i ".c") "\n"))
+	    (system (format "cp " (split-path cached.path i ".c") " " (split-path base i ".c"))))
+	#t)
+      #f))
+
+(define (save-output cached base n)
+  (for-range
+      i n
+      (let ((path (split-path cached.path i ".c")))
+	(system (format "mkdir -p $(dirname " path ") && cp " (split-path base i ".c") " " (temp-path path) " && mv " (temp-path path) " " path))))
+  (write-cache-key (format cached.path ".key") cached.digest))
+
+(define (maybe-invoke-cc base options)
+  (when (not options.nocompile)
+	(print-string "compiling...\n")
+	(invoke-cc base options)
+	#u))
 
 (define (get-options argv options)
   (let ((filename-index 1))
@@ -60,6 +226,9 @@
 	  "-f" -> (begin
 		    (set! i (+ i 1))
 		    (set! options.extra-cflags argv[i]))
+	  "-j" -> (begin
+		    (set! i (+ i 1))
+		    (set! options.split (max 1 (string->int argv[i]))))
 	  "-I" -> (begin
 		    (set! i (+ i 1))
 		    (PUSH options.include-dirs argv[i]))
@@ -72,6 +241,8 @@
 		   (raise (:UnknownOption "Unknown option" x))
 		   (set! filename-index i))
 	  ))
+    ;; the profile counters are per-file, so keep the output whole.
+    (if options.profile (set! options.split 1))
     filename-index))
 
 (define (usage)
@@ -86,6 +257,7 @@ Usage: compile <irken-src-file> [options]
  -O : tell CC to optimize
  -p : generate profile-printing code
  -n : disable letreg optimization
+ -j : split the C output over <n> files, compiled in parallel
 "))
 
 (defmacro verbose
@@ -97,13 +269,20 @@ Usage: compile <irken-src-file> [options]
   (when (< sys.argc 2)
 	(usage)
 	(raise (:args)))
+  (let/cc return
   (let ((filearg (get-options sys.argv the-context.options))
 	(transform (transformer))
 	(path sys.argv[filearg])
 	(base (find-base path))
-	(opath (string-append base ".c"))
 	(forms0 (read-file path))
 	(forms1 (prepend-standard-macros forms0))
+	(cached (output-cache-key forms1 the-context.options))
+	(_ (match cached with
+	     (maybe:yes cached)
+	     -> (when (restore-output cached base the-context.options.split)
+		  (maybe-invoke-cc base the-context.options)
+		  (return #u))
+	     (maybe:no) -> #u))
 	(exp0 (sexp:list forms1))
 	(_ (verbose (pp 0 exp0) (newline)))
 	(exp1 (transform exp0))
@@ -144,11 +323,12 @@ Usage: compile <irken-src-file> [options]
 	(_ (print-string "cps...\n"))
 	(cps (compile noden))
 	(_ (set! noden (node/sequence '()))) ;; go easier on memory
-	(ofile (file/open-write opath #t #o644))
-	(o (make-writer ofile))
-	(tmp-path (format base ".tmp.c"))
-	(tfile (file/open-write tmp-path #t #o644))
-	(o0 (make-writer tfile))
+	(nfiles the-context.options.split)
+	(os (list->vector
+	     (map-range i nfiles (make-writer (file/open-write (split-path base i ".c") #t #o644)))))
+	(tmp-paths (list->vector (map-range i nfiles (split-path base i ".tmp.c"))))
+	(o0s (list->vector
+	      (map-range i nfiles (make-writer (file/open-write tmp-paths[i] #t #o644)))))
 	)
     (verbose
      (print-string "\n-- RTL --\n")
@@ -187,33 +367,48 @@ Usage: compile <irken-src-file> [options]
 	the-context.exceptions)
      )
     (print-string "\n-- C output --\n")
-    (print-string " : ") (print-string opath) (newline)
-    (for-each (lambda (path)
-		(o.write (format "#include <" path ">")))
-	      (reverse the-context.cincludes))
-    (for-each o.write (reverse the-context.cverbatim))
+    (for-range
+	i nfiles
+	(print-string (format " : " (split-path base i ".c") "\n")))
     (match (get-header-parts the-context.options.include-dirs) with
       (:header part0 part1 part2)
-      -> (begin (o.copy part0)
-		(emit-constructed o)
-		(if the-context.options.profile (emit-profile-0 o))
-		(o.copy part1)
-		(o.copy part2)
-		(emit o0 o cps)))
-    (emit-lookup-field o)
-    (if the-context.options.profile (emit-profile-1 o))
+      -> (for-range
+	     i nfiles
+	     (let ((o os[i]))
+	       ;; must precede any #include: makes mmap & friends visible under -std=c99
+	       (o.write "#define _DEFAULT_SOURCE")
+	       (when (> nfiles 1)
+		 (o.write "#define PXLL_SPLIT")
+		 (if (> i 0) (o.write "#define PXLL_SPLIT_UNIT")))
+	       (for-each (lambda (path)
+			   (o.write (format "#include <" path ">")))
+			 (reverse the-context.cincludes))
+	       (for-each o.write (reverse the-context.cverbatim))
+	       (o.copy part0)
+	       (if (= i 0)
+		   (emit-constructed o)
+		   (emit-constructed-externs o))
+	       (if the-context.options.profile (emit-profile-0 o))
+	       (o.copy part1)
+	       (o.copy part2))))
+    (emit (make-split-writer o0s) (make-tee-writer os) cps)
     (print-string "done.\n")
-    (o0.close)
-    ;; copy code after declarations
-    (o.copy (read-file-contents (file/open-read tmp-path)))
-    (o.close)
-    (unlink tmp-path)
-    (when (not the-context.options.nocompile)
-	  (print-string "compiling...\n")
-	  (invoke-cc base the-context.options)
-	  #u
-	  )
-    )
+    (for-range
+	i nfiles
+	(let ((o os[i])
+	      (o0 o0s[i]))
+	  (emit-lookup-field o)
+	  (if the-context.options.profile (emit-profile-1 o))
+	  (o0.close)
+	  ;; copy code after declarations
+	  (o.copy (read-file-contents (file/open-read tmp-paths[i])))
+	  (o.close)
+	  (unlink tmp-paths[i])))
+    (match cached with
+      (maybe:yes cached) -> (save-output cached base nfiles)
+      (maybe:no) -> #u)
+    (maybe-invoke-cc base the-context.options)
+    ))
   )
   
 (main)
@@ -10,6 +10,7 @@
    profile		= #f
    noinline		= #f
    noletreg		= #f
+   split		= 1
    include-dirs		= (LIST "." (getenv-or "IRKENLIB" "/usr/local/lib/irken/"))
    })
 
@@ -37,6 +38,15 @@
     }
   )
 
+;; a variant record's typecode is UOTAG(index) (see include/pxll.h), which
+;;   must fit in the low byte of its header: indexes run from 0 to 48.
+;;   polymorphic variant labels are numbered across the whole program.
+(define max-variant-tags 49)
+
+(define (check-variant-tag index what)
+  (when (>= index max-variant-tags)
+	(error1 (format "too many variants (at most " (int max-variant-tags) "):") what)))
+
 ;; XXX a builtin flags object would be nice...
 
 (define (vars-get-var name)
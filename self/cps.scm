@@ -334,6 +334,9 @@
    
     (define (c-cexp sig template exp lenv k)
       ;;(print-string (format "c-cexp: sig = " (type-repr sig) " solved type = " (type-repr exp.type) "\n"))
+      (if (is-pred? exp.type 'float)
+	  ;; floats are boxed on the heap
+	  (set-flag! VFLAG-ALLOCATES))
       (collect-primargs exp.subs lenv k
 			(lambda (regs)
 			  (insn:cexp sig exp.type template regs k))))
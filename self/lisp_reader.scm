@@ -413,15 +413,22 @@
       (:OSError _) -> (find-file dirs name)
       ))
 
+;; the file is mapped and read in place.  the reader builds new strings
+;;   for everything it keeps, so the mapping can go once it's done.
+(define (read-mapped-file file)
+  (let ((text (map-file file.fd))
+	(forms (reader (string-reader text))))
+    (unmap-file text)
+    (file/close file)
+    forms))
+
 (define (read-file path)
   (print-string "reading file ") (printn path)
-  (let ((file (file/open-read path)))
-    (reader (lambda () (file/read-char file)))))
+  (read-mapped-file (file/open-read path)))
 
 (define (find-and-read-file path)
   (print-string "reading file ") (printn path)
-  (let ((file (find-file the-context.options.include-dirs path)))
-    (reader (lambda () (file/read-char file)))))
+  (read-mapped-file (find-file the-context.options.include-dirs path)))
 
 (define (read-string s)
   (reader (string-reader s)))
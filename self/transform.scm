@@ -275,6 +275,7 @@
 	(alt-map::get-err tag "no such alt in datatype"))
 
       (define (add alt)
+	(check-variant-tag nalts (string->symbol (format (sym name) ":" (sym alt.name))))
 	(alt-map::add alt.name alt)
 	(set! alt.index nalts)
 	(set! nalts (+ 1 nalts))
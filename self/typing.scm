@@ -160,45 +160,43 @@
 				       (maybe:yes tv) -> tv
 				       (maybe:no) -> t)))))
 
-  (define (occurs-in-type tvar type)
-    (let/cc return
-	(if (eq? tvar type)
-	    #t
-	    (match type with
-	      (type:tvar _ _) -> #f
-	      (type:pred _ args _)
-	      -> (begin
-		   (for-each
-		    (lambda (arg)
-		      (if (occurs-in-type tvar arg) (return #t) #u))
-		    args)
-		   #f)))))
-
-  ;; occurs-free and build-type-scheme could obviously
-  ;;   be made more efficient - build-type-scheme walks
-  ;;   the entire environment repeatedly.
-  (define (occurs-free-in-tenv tvar tenv)
-    (let/cc return
-	(alist/iterate
-	 (lambda (name scheme)
-	   (match scheme with
-	     (:scheme gens type)
-	     -> (if (not (member-eq? tvar gens))
-		    (if (occurs-in-type tvar type)
-			(return #t)))))
-	 tenv)
-      #f))
+  ;; the members of <candidates> that occur free in <tenv>.  one pass over the
+  ;;   environment checks every candidate at once, and stops early once
+  ;;   all of them have been seen.
+  (define (free-in-tenv candidates tenv)
+    (let ((free (set-maker '()))
+	  (left (length (candidates::get))))
+      (let/cc return
+	  (alist/iterate
+	   (lambda (name scheme)
+	     (match scheme with
+	       (:scheme gens type)
+	       -> (let walk ((t type))
+		    (match t with
+		      (type:pred _ args _) -> (for-each walk args)
+		      (type:tvar _ _)
+		      -> (when (and (candidates::in t)
+				    (not (free::in t))
+				    (not (member-eq? t gens)))
+			   (free::add t)
+			   (set! left (- left 1))
+			   (if (= left 0) (return free)))))))
+	   tenv)
+	free)))
 
   (define (build-type-scheme type tenv)
-    (let ((gens (set-maker '())))
-      (define (find-generic-tvars t)
+    (let ((type (apply-subst type))
+	  (tvars (set-maker '())))
+      (let walk ((t type))
 	(match t with
-	  (type:tvar _ _)      -> (if (not (occurs-free-in-tenv t tenv)) (gens::add t))
-	  (type:pred _ args _) -> (for-each find-generic-tvars args)))
-      (let ((type (apply-subst type)))
-	(find-generic-tvars type)
-	;;(print-string (format "build-type-scheme type=" (type-repr type) " gens = " (join type-repr "," (gens::get)) "\n"))
-	(:scheme (gens::get) type))))
+	  (type:tvar _ _)      -> (tvars::add t)
+	  (type:pred _ args _) -> (for-each walk args)))
+      (let ((gens (if (null? (tvars::get))
+		      '()
+		      (let ((free (free-in-tenv tvars tenv)))
+			(filter (lambda (t) (not (free::in t))) (tvars::get))))))
+	;;(print-string (format "build-type-scheme type=" (type-repr type) " gens = " (join type-repr "," gens) "\n"))
+	(:scheme gens type))))
 
   (define (type-of* exp tenv)
     (match exp.t with
@@ -472,6 +470,7 @@
     (match (alist/lookup the-context.variant-labels label) with
       (maybe:yes _) -> #u
       (maybe:no) -> (let ((index (alist/length the-context.variant-labels)))
+		      (check-variant-tag index label)
 		      (alist/push the-context.variant-labels label index))))
 
   (define T0 (new-tvar))
@@ -0,0 +1,13 @@
+;; -*- Mode: Irken -*-
+
+;; only 49 variant tags fit in a typecode, and polymorphic variant
+;;   labels are numbered across the whole program.
+
+(include "lib/core.scm")
+(include "lib/pair.scm")
+
+(length (LIST (:l0 0) (:l1 1) (:l2 2) (:l3 3) (:l4 4) (:l5 5) (:l6 6) (:l7 7) (:l8 8) (:l9 9)
+  (:l10 10) (:l11 11) (:l12 12) (:l13 13) (:l14 14) (:l15 15) (:l16 16) (:l17 17) (:l18 18) (:l19 19)
+  (:l20 20) (:l21 21) (:l22 22) (:l23 23) (:l24 24) (:l25 25) (:l26 26) (:l27 27) (:l28 28) (:l29 29)
+  (:l30 30) (:l31 31) (:l32 32) (:l33 33) (:l34 34) (:l35 35) (:l36 36) (:l37 37) (:l38 38) (:l39 39)
+  (:l40 40) (:l41 41) (:l42 42) (:l43 43) (:l44 44) (:l45 45) (:l46 46) (:l47 47) (:l48 48) (:l49 49)))
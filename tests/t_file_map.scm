@@ -0,0 +1,25 @@
+;; -*- Mode: Irken -*-
+
+(include "lib/basis.scm")
+
+(define (count-char s ch)
+  (let loop ((i 0) (n 0))
+    (cond ((= i (string-length s)) n)
+	  ((eq? (string-ref s i) ch) (loop (+ i 1) (+ n 1)))
+	  (else (loop (+ i 1) n)))))
+
+(let ((s (file/map "tests/t_file_map.scm")))
+  (printn (string-length s))
+  (printn (count-char s #\newline))
+  ;; the mapped string is outside the heap: collections leave it alone.
+  (let loop ((i 0) (l '()))
+    (if (< i 100000)
+	(loop (+ i 1) (list:cons (make-string 10) (if (> (length l) 50) '() l)))
+	#u))
+  (printn (substring s 0 21))
+  (unmap-file s))
+
+(try
+ (file/map "tests/no-such-file")
+ except
+ (:OSError e) -> (begin (printn "no such file") ""))
@@ -0,0 +1,29 @@
+;; -*- Mode: Irken -*-
+
+(include "lib/core.scm")
+(include "lib/pair.scm")
+(include "lib/string.scm")
+(include "lib/float.scm")
+
+;; the partial sums stay unboxed inside the loop body, the loop
+;;   variable is boxed on each trip around.
+(define (harmonic n)
+  (let loop ((i 1) (sum (int->float 0)))
+    (if (> i n)
+	sum
+	(loop (+ i 1) (float+ sum (float/ (int->float 1) (int->float i)))))))
+
+(define (poly x)
+  ;; 3x^2 - 2x + 1
+  (float+ (float- (float* (int->float 3) (float* x x))
+		  (float* (int->float 2) x))
+	  (int->float 1)))
+
+(let ((h (harmonic 1000))
+      (l (map (lambda (i) (poly (float/ (int->float i) (int->float 4)))) (range 5))))
+  (printn (float->int (float* h (int->float 1000))))
+  (printn l)
+  (print-string (float->string (float/ (int->float 1) (int->float 3))))
+  (newline)
+  (printn (float< (car l) (nth l 1)))
+  (float->string (float-neg (int->float 7))))
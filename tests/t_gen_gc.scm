@@ -0,0 +1,41 @@
+;; -*- Mode: Irken -*-
+
+;; exercise the generational collector: objects that have been promoted
+;;   to the old generation are repeatedly updated to point at young ones.
+
+(cverbatim "#define PXLL_GENERATIONAL 1")
+
+(include "lib/core.scm")
+(include "lib/pair.scm")
+
+(define counter 0)
+(define latest (list:nil))
+
+(define (garbage n)
+  ;; enough allocation to force many minor collections
+  (let loop ((i 0) (l (list:nil)))
+    (if (= i n)
+	(length l)
+	(loop (+ i 1) (list:cons i l)))))
+
+(let ((v (make-vector 1000 (list:nil)))
+      (r {a=0 b=(list:nil)}))
+  ;; make sure v and r have been promoted
+  (garbage 100000)
+  (let loop ((n 0))
+    (cond ((= n 20000)
+	   (printn (length latest))
+	   (printn r.a)
+	   (printn (length r.b))
+	   (let sum ((i 0) (total 0))
+	     (if (= i 1000)
+		 total
+		 (sum (+ i 1) (+ total (length v[i]))))))
+	  (else
+	   (set! v[(remainder n 1000)] (list:cons n v[(remainder n 1000)]))
+	   (set! r.a n)
+	   (set! r.b (list:cons n r.b))
+	   (set! counter (+ counter 1))
+	   (set! latest (list:cons counter latest))
+	   (garbage 100)
+	   (loop (+ n 1))))))
@@ -0,0 +1,40 @@
+;; -*- Mode: Irken -*-
+
+(include "lib/core.scm")
+(include "lib/pair.scm")
+(include "lib/string.scm")
+(include "lib/aa_map.scm")
+(include "lib/symbol.scm")
+(include "lib/hashtable.scm")
+
+(define (sum-values t)
+  (let ((sum 0))
+    (t::iterate (lambda (k v) (set! sum (+ sum v))))
+    sum))
+
+(let ((t (make-string-table))
+      (n (make-int-table))
+      (s (make-symbol-table)))
+  (for-range i 10000 (t::add (int->string i) i))
+  (for-range i 10000 (t::add (int->string i) (* 2 i))) ;; replace
+  (printn (t::count))
+  (printn (t::get "1234"))
+  (printn (t::get "10000"))
+  ;; delete the odd keys
+  (for-range i 5000 (t::del (int->string (+ 1 (* 2 i)))))
+  (printn (t::count))
+  (printn (t::get "4321"))
+  (printn (t::get "4322"))
+  (printn (sum-values t))
+  ;; negative and colliding int keys
+  (for-range i 1000 (n::add (- (* i 1024) 500000) i))
+  (printn (n::get -500000))
+  (printn (n::get (- (* 999 1024) 500000)))
+  (n::del -500000)
+  (printn (n::get -500000))
+  (printn (n::count))
+  (s::add 'apple 1)
+  (s::add 'banana 2)
+  (s::del 'apple)
+  (printn (s::get 'banana))
+  (s::get 'apple))
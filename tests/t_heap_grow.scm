@@ -0,0 +1,20 @@
+;; -*- Mode: Irken -*-
+
+;; keep far more data live than fits in the initial heap, then let most
+;;   of it go so that the heap can shrink again.
+
+(include "lib/core.scm")
+(include "lib/pair.scm")
+
+(define (build n)
+  (let loop ((i 0) (l (list:nil)))
+    (if (= i n)
+	l
+	(loop (+ i 1) (list:cons i l)))))
+
+(let ((big (build 2000000)))
+  (printn (length big))
+  (let loop ((n 100) (total 0))
+    (if (= n 0)
+	total
+	(loop (- n 1) (+ total (length (build 10000)))))))
@@ -0,0 +1,52 @@
+;; -*- Mode: Irken -*-
+
+;; exercise the incremental collector: the old generation fills with
+;;   promoted garbage, so cycles run while old objects (including the
+;;   contents of strings) keep changing underneath them.
+
+(cverbatim "#define PXLL_INCREMENTAL 1")
+(cverbatim "#define PXLL_GC_PAUSE 20")
+
+(include "lib/core.scm")
+(include "lib/pair.scm")
+(include "lib/string.scm")
+
+(define (make-list n)
+  (let loop ((i 0) (l (list:nil)))
+    (if (= i n)
+	l
+	(loop (+ i 1) (list:cons i l)))))
+
+(define (count-char s ch)
+  (let loop ((i 0) (n 0))
+    (cond ((= i (string-length s)) n)
+	  ((char=? (string-ref s i) ch) (loop (+ i 1) (+ n 1)))
+	  (else (loop (+ i 1) n)))))
+
+(let ((window (make-vector 8 (list:nil)))
+      (v (make-vector 1000 (list:nil)))
+      (strings (make-vector 100 ""))
+      (r {a=0 b=(list:nil)}))
+  (for-range i 100 (set! strings[i] (make-string 100)))
+  (for-range i 100 (for-range j 100 (string-set! strings[i] j #\a)))
+  (let loop ((n 0))
+    (cond ((= n 20000)
+	   (printn r.a)
+	   (printn (length r.b))
+	   (let sum ((i 0) (total 0))
+	     (if (= i 1000)
+		 (printn total)
+		 (sum (+ i 1) (+ total (length v[i])))))
+	   (let sum ((i 0) (total 0))
+	     (if (= i 100)
+		 (printn total)
+		 (sum (+ i 1) (+ total (count-char strings[i] #\b)))))
+	   (length window[0]))
+	  (else
+	   ;; lives long enough to be promoted, then is garbage.
+	   (set! window[(remainder n 8)] (make-list 1000))
+	   (set! v[(remainder n 1000)] (list:cons n v[(remainder n 1000)]))
+	   (string-set! strings[(remainder n 100)] (remainder (/ n 100) 100) #\b)
+	   (set! r.a n)
+	   (set! r.b (list:cons n r.b))
+	   (loop (+ n 1))))))
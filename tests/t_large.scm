@@ -0,0 +1,37 @@
+;; -*- Mode: Irken -*-
+
+;; big strings live outside the heap: they must keep their address and
+;;   contents across collections, and the ones dropped must be freed.
+
+(include "lib/core.scm")
+(include "lib/pair.scm")
+(include "lib/string.scm")
+
+(define (address s)
+  (%%cexp (string -> int) "((pxll_int) %0 >> 3)" s))
+
+(define (large-count)
+  (%%cexp (-> int) "large_count"))
+
+(define (garbage n)
+  (let loop ((i 0) (l (list:nil)))
+    (if (= i n)
+	(length l)
+	(loop (+ i 1) (list:cons i l)))))
+
+(let ((keep (make-string 1000000))
+      (small (make-string 100)))
+  (string-set! keep 0 #\a)
+  (string-set! keep 999999 #\z)
+  (let ((where (address keep)))
+    ;; lots of big garbage, and enough small garbage to collect.
+    (let loop ((n 0))
+      (when (< n 200)
+	    (string-set! (make-string 200000) 0 #\x)
+	    (garbage 10000)
+	    (loop (+ n 1))))
+    (printn (= where (address keep)))
+    (printn (string-ref keep 0))
+    (printn (string-ref keep 999999))
+    (printn (string-length small))
+    (< (large-count) 50)))
@@ -0,0 +1,37 @@
+;; -*- Mode: Irken -*-
+
+(include "lib/core.scm")
+(include "lib/pair.scm")
+(include "lib/string.scm")
+(include "lib/float.scm")
+(include "lib/packed.scm")
+
+;; big enough that the collector has to move them around a few times.
+(define (fill-f64 n)
+  (let ((v (make-f64vec n)))
+    (for-range i n (f64vec-set! v i (float/ (int->float i) (int->float 2))))
+    v))
+
+(define (sum-f64 v)
+  (let loop ((i 0) (sum (int->float 0)))
+    (if (= i (f64vec-length v))
+	sum
+	(loop (+ i 1) (float+ sum (f64vec-ref v i))))))
+
+(let ((vs (map (lambda (i) (fill-f64 100000)) (range 20)))
+      (i64 (make-i64vec 3))
+      (i32 (make-i32vec 3))
+      (u8 (make-u8vec 4)))
+  (printn (float->int (sum-f64 (nth vs 19))))
+  (i64vec-set! i64 0 1000000000000)
+  (i64vec-set! i64 2 -7)
+  (i32vec-set! i32 1 -123456)
+  (u8vec-set! u8 0 255)
+  (u8vec-set! u8 3 257)
+  (let ((f (make-f64vec 2)))
+    (f64vec-set! f 1 (float/ (int->float 5) (int->float 2)))
+    (printn f))
+  (printn i64)
+  (printn i32)
+  (printn u8)
+  (+ (i64vec-ref i64 0) (u8vec-ref u8 3)))
@@ -0,0 +1,41 @@
+;; -*- Mode: Irken -*-
+
+;; a live set big enough for the parallel collector, and a vector
+;;   of references to it for the threads to race over.
+
+(cverbatim "#define PXLL_PARALLEL_GC 1")
+(cverbatim "#define PXLL_GC_THREADS 4")
+
+(include "lib/core.scm")
+(include "lib/pair.scm")
+
+(datatype tree
+  (:leaf int)
+  (:node (tree 'a) (tree 'a))
+  )
+
+(define (build d)
+  (if (= d 0)
+      (tree:leaf 1)
+      (tree:node (build (- d 1)) (build (- d 1)))))
+
+(define count
+  (tree:leaf n)   -> n
+  (tree:node l r) -> (+ (count l) (count r))
+  )
+
+(define (garbage n)
+  (let loop ((i 0) (l (list:nil)))
+    (if (= i n)
+	(length l)
+	(loop (+ i 1) (list:cons i l)))))
+
+(let ((t (build 19))
+      (v (make-vector 1000 (tree:leaf 0))))
+  (for-range i 1000 (set! v[i] t))
+  (printn (count t))
+  (let loop ((n 50))
+    (cond ((= n 0) (count v[999]))
+	  (else
+	   (garbage 200000)
+	   (loop (- n 1))))))
@@ -0,0 +1,37 @@
+;; -*- Mode: Irken -*-
+
+;; a pinned string never moves, however small, and is freed once it is
+;;   no longer referenced.
+
+(include "lib/core.scm")
+(include "lib/pair.scm")
+(include "lib/string.scm")
+
+(define (address s)
+  (%%cexp (string -> int) "((pxll_int) %0 >> 3)" s))
+
+(define (large-count)
+  (%%cexp (-> int) "large_count"))
+
+(define (garbage n)
+  (let loop ((i 0) (l (list:nil)))
+    (if (= i n)
+	(length l)
+	(loop (+ i 1) (list:cons i l)))))
+
+(let ((keep (make-pinned-string 16))
+      (small (make-string 16)))
+  (string-set! keep 0 #\a)
+  (string-set! keep 15 #\z)
+  (let ((where (address keep)))
+    (let loop ((n 0))
+      (when (< n 5000)
+	    (string-set! (make-pinned-string 4000) 0 #\x)
+	    (garbage 1000)
+	    (loop (+ n 1))))
+    (printn (= where (address keep)))
+    (printn (string-ref keep 0))
+    (printn (string-ref keep 15))
+    (printn (string-pinned? keep))
+    (printn (string-pinned? small))
+    (< (large-count) 2500)))
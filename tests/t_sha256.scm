@@ -0,0 +1,17 @@
+;; -*- Mode: Irken -*-
+
+(include "lib/basis.scm")
+(include "lib/sha256.scm")
+
+(define (print-line s)
+  (print-string s)
+  (newline))
+
+(print-line (sha256 ""))
+(print-line (sha256 "abc"))
+;; 56 bytes: the length goes in a second padding block.
+(print-line (sha256 "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"))
+(let ((s (make-string 1000)))
+  (for-range i 1000 (string-set! s i (ascii->char (+ 32 (remainder i 90)))))
+  (print-line (sha256 s))
+  #u)
@@ -0,0 +1,59 @@
+;; -*- Mode: Irken -*-
+
+(include "lib/basis.scm")
+(cverbatim "
+#include <sys/wait.h>
+#include <signal.h>
+static int child_aborted (int pid)
+{
+  int status;
+  waitpid (pid, &status, 0);
+  return WIFSIGNALED (status) && WTERMSIG (status) == SIGABRT;
+}
+")
+
+(define (print-slice sl)
+  (print-string (slice->string sl))
+  (print-string "\n"))
+
+;; a tiny buffer, so lines are moved to the front and the buffer grows.
+(let ((f (file/open-read "tests/t_slice.scm")))
+  (set! f.buf (make-string 16))
+  (let loop ((n 0)
+	     (longest 0))
+    (match (file/read-line f) with
+      (maybe:yes line)
+      -> (begin
+	   (print-slice line)
+	   (loop (+ n 1) (max longest (slice-length line))))
+      (maybe:no)
+      -> (printf "lines=" (int n) " longest=" (int longest) "\n")))
+  (file/close f))
+
+;; does <thunk> stop the program with a range check?  it is run in a
+;;   child process, so that this one can carry on.
+(define (aborts? thunk)
+  (let ((pid (%%cexp (-> int) "(fflush (stdout), fork())")))
+    (cond ((= pid 0)
+	   (%%cexp (-> undefined) "freopen (\"/dev/null\", \"w\", stderr)")
+	   (thunk)
+	   (%%cexp (-> undefined) "exit (0)")
+	   #f)
+	  (else
+	   (%%cexp (int -> bool) "child_aborted (%0)" pid)))))
+
+(let ((sl (subslice (string->slice "(one two three)") 1 14)))
+  (for-each print-slice (slice-split sl #\space))
+  (printn (slice=? (subslice sl 4 7) (string->slice "two")))
+  (printn (slice-compare (subslice sl 0 3) (subslice sl 4 7)))
+  (printn (slice-ref sl 2))
+  (printn (slice-find-char sl #\e))
+  (printn (aborts? (lambda () (subslice sl 6 2))))
+  (printn (aborts? (lambda () (subslice sl -1 2))))
+  (printn (aborts? (lambda () (subslice sl 0 14))))
+  (printn (aborts? (lambda () (make-slice "hello" -1 3))))
+  (printn (aborts? (lambda () (make-slice "hello" 6 0))))
+  (printn (aborts? (lambda () (make-slice "hello" 2 -1))))
+  (printn (aborts? (lambda () (make-slice "hello" 2 4))))
+  (printn (aborts? (lambda () (make-slice "hello" 5 0))))
+  (slice->string (subslice sl 8 13)))
@@ -0,0 +1,46 @@
+;; -*- Mode: Irken -*-
+
+;; continuation frames on a (deliberately tiny) stack: deep recursion
+;;   overflows it, and generators and escapes capture frames from it.
+
+(cverbatim "#define PXLL_STACK_FRAMES 1")
+(cverbatim "#define PXLL_STACK_WORDS 4096")
+
+(include "lib/core.scm")
+(include "lib/pair.scm")
+
+(define (build n)
+  (if (= n 0)
+      (list:nil)
+      (list:cons n (build (- n 1)))))
+
+(define (sum l)
+  (match l with
+    () -> 0
+    (hd . tl) -> (+ hd (sum tl))))
+
+(define (find-first-under n l)
+  (callcc
+   (lambda (k)
+     (let loop ((l l))
+       (match l with
+	 () -> 0
+	 (hd . tl) -> (+ 1 (if (< hd n) (throw k hd) (loop tl))))))))
+
+(define (counter n)
+  (make-generator
+   (lambda (yield)
+     (let loop ((i 0))
+       (if (= i n)
+	   (forever (yield -1))
+	   (begin (yield (+ 1 (sum (build i))))
+		  (loop (+ i 1))))))))
+
+(let ((l (build 100000))
+      (g (counter 100)))
+  (printn (sum l))
+  (printn (find-first-under 10 l))
+  (let loop ((i 0) (acc 0))
+    (if (= i 100)
+	acc
+	(loop (+ i 1) (+ acc (g))))))